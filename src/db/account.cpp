@@ -26,13 +26,14 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "account.h"
 
-#include <algorithm>
 #include <cstring>
 
 #include "common/error.h"
 #include "common/expect.h"
 #include "db/data.h"
 #include "db/string.h"
+#include "memwipe.h"  // monero/contrib/epee/include
+#include "mlocker.h"  // monero/contrib/epee/include
 #include "wire/adapted/crypto.h"
 #include "wire/adapted/pair.h"
 #include "wire/msgpack.h"
@@ -43,24 +44,41 @@ namespace lws
 {
   namespace
   {
-    // update if `crypto::public_key` gets `operator<`
-    struct sort_pubs
+    //! Same recoding as `ge_scalarmult` in monero/src/crypto/crypto-ops.c
+    void recode_scalar(std::array<std::int8_t, 64>& e, crypto::secret_key const& key) noexcept
     {
-      bool operator()(crypto::public_key const& lhs, crypto::public_key const& rhs) const noexcept
+      const auto* const a =
+        reinterpret_cast<const unsigned char*>(std::addressof(tools::unwrap(key)));
+
+      int carry = 0;  /* 0..1 */
+      int carry2 = 0;
+      for (unsigned i = 0; i < 31; ++i)
       {
-        return std::memcmp(std::addressof(lhs), std::addressof(rhs), sizeof(lhs)) < 0;
+        carry += a[i];                        /* 0..256 */
+        carry2 = (carry + 8) >> 4;            /* 0..16 */
+        e[2 * i] = carry - (carry2 << 4);     /* -8..7 */
+        carry = (carry2 + 8) >> 4;            /* 0..1 */
+        e[2 * i + 1] = carry2 - (carry << 4); /* -8..7 */
       }
-    };
+      carry += a[31];                         /* 0..128 */
+      carry2 = (carry + 8) >> 4;              /* 0..8 */
+      e[62] = carry - (carry2 << 4);          /* -8..7 */
+      e[63] = carry2;                         /* 0..8 */
+
+      // both are derived from the view key
+      memwipe(std::addressof(carry), sizeof(carry));
+      memwipe(std::addressof(carry2), sizeof(carry2));
+    }
   }
 
   struct account::internal
   {
     internal()
-      : address(), id(db::account_id::invalid), pubs{}, view_key{}
+      : address(), id(db::account_id::invalid), pubs{}, view_key{}, view_key_digits{}
     {}
 
     explicit internal(db::account const& source)
-      : address(db::address_string(source.address)), id(source.id), pubs(source.address), view_key()
+      : address(db::address_string(source.address)), id(source.id), pubs(source.address), view_key(), view_key_digits{}
     {
       using inner_type =
         std::remove_reference<decltype(tools::unwrap(view_key))>::type;
@@ -73,10 +91,14 @@ namespace lws
         std::addressof(source.key),
         sizeof(source.key)
       );
+      recode_scalar(view_key_digits, view_key);
     }
 
     void read_bytes(wire::msgpack_reader& source)
-    { map(source, *this); }
+    {
+      map(source, *this);
+      recode_scalar(view_key_digits, view_key); // overwritten in place
+    }
 
     void write_bytes(wire::msgpack_writer& dest) const
     { map(dest, *this); }
@@ -96,10 +118,33 @@ namespace lws
     db::account_id id;
     db::account_address pubs;
     crypto::secret_key view_key;
+    //! Not serialized, computed from `view_key`. Scrubbed and locked, same as `view_key`.
+    epee::mlocked<tools::scrubbed<std::array<std::int8_t, 64>>> view_key_digits;
+  };
+
+  //! Subaddress spend public keys of an account
+  struct account::subaddresses
+  {
+    struct traits
+    {
+      static crypto::public_key const& key(db::subaddress_map const& value) noexcept { return value.subaddress; }
+      static std::size_t hash(crypto::public_key const& key) noexcept { return pub_traits::hash(key); }
+    };
+
+    explicit subaddresses(std::vector<db::subaddress_map> source)
+      : keys()
+    {
+      keys.reserve(source.size());
+      for (db::subaddress_map const& key : source)
+        keys.insert(key);
+    }
+
+    db::flat_hash_set<db::subaddress_map, traits> keys;
   };
 
-  account::account(std::shared_ptr<const internal> immutable, db::block_id height, std::vector<std::pair<db::output_id, db::address_index>> spendable, std::vector<crypto::public_key> pubs) noexcept
+  account::account(std::shared_ptr<const internal> immutable, db::block_id height, spendable_set spendable, pub_set pubs) noexcept
     : immutable_(std::move(immutable))
+    , subaddresses_(nullptr)
     , spendable_(std::move(spendable))
     , pubs_(std::move(pubs))
     , spends_()
@@ -127,14 +172,19 @@ namespace lws
   }
 
   account::account() noexcept
-    : immutable_(nullptr), spendable_(), pubs_(), spends_(), outputs_(), height_(db::block_id(0))
+    : immutable_(nullptr), subaddresses_(nullptr), spendable_(), pubs_(), spends_(), outputs_(), height_(db::block_id(0))
   {}
 
   account::account(db::account const& source, std::vector<std::pair<db::output_id, db::address_index>> spendable, std::vector<crypto::public_key> pubs)
-    : account(std::make_shared<internal>(source), source.scan_height, std::move(spendable), std::move(pubs))
+    : account(std::make_shared<internal>(source), source.scan_height, {}, {})
   {
-    std::sort(spendable_.begin(), spendable_.end());
-    std::sort(pubs_.begin(), pubs_.end(), sort_pubs{});
+    spendable_.reserve(spendable.size());
+    for (auto const& value : spendable)
+      spendable_.insert(value);
+
+    pubs_.reserve(pubs.size());
+    for (auto const& pub : pubs)
+      pubs_.insert(pub);
   }
 
   account::~account() noexcept
@@ -145,8 +195,6 @@ namespace lws
     auto immutable = std::make_shared<internal>();
     map(source, *this, *immutable);
     immutable_ = std::move(immutable);
-    std::sort(spendable_.begin(), spendable_.end());
-    std::sort(pubs_.begin(), pubs_.end(), sort_pubs{});
   }
 
   void account::write_bytes(::wire::msgpack_writer& dest) const
@@ -158,6 +206,7 @@ namespace lws
   account account::clone() const
   {
     account result{immutable_, height_, spendable_, pubs_};
+    result.subaddresses_ = subaddresses_;
     result.outputs_ = outputs_;
     result.spends_ = spends_;
     return result;
@@ -172,6 +221,15 @@ namespace lws
     outputs_.shrink_to_fit();
   }
 
+  account account::split_update(const db::block_id new_height)
+  {
+    account result{immutable_, height_, {}, {}};
+    result.outputs_ = std::move(outputs_);
+    result.spends_ = std::move(spends_);
+    updated(new_height);
+    return result;
+  }
+
   db::account_id account::id() const noexcept
   {
     if (immutable_)
@@ -209,29 +267,51 @@ namespace lws
     return immutable_->view_key;
   }
 
+  std::array<std::int8_t, 64> const& account::view_key_digits() const
+  {
+    null_check();
+    return immutable_->view_key_digits;
+  }
+
+  std::size_t account::subaddress_count() const noexcept
+  {
+    if (subaddresses_)
+      return subaddresses_->keys.size();
+    return 0;
+  }
+
+  void account::set_subaddresses(std::vector<db::subaddress_map> keys)
+  {
+    if (keys.empty())
+      subaddresses_ = nullptr;
+    else
+      subaddresses_ = std::make_shared<subaddresses>(std::move(keys));
+  }
+
+  boost::optional<db::address_index> account::find_subaddress(crypto::public_key const& spend_public) const noexcept
+  {
+    if (!subaddresses_)
+      return boost::none;
+    const auto* const key = subaddresses_->keys.find(spend_public);
+    if (!key)
+      return boost::none;
+    return key->index;
+  }
+
   boost::optional<db::address_index> account::get_spendable(db::output_id const& id) const noexcept
   {
-    const auto searchable = 
-      std::make_pair(id, db::address_index{db::major_index::primary, db::minor_index::primary});
-    const auto account =
-      std::lower_bound(spendable_.begin(), spendable_.end(), searchable);
-    if (account == spendable_.end() || account->first != id)
+    const auto* const spendable = spendable_.find(id);
+    if (!spendable)
       return boost::none;
-    return account->second;
+    return spendable->second;
   }
 
   bool account::add_out(db::output const& out)
   {
-    auto existing_pub = std::lower_bound(pubs_.begin(), pubs_.end(), out.pub, sort_pubs{});
-    if (existing_pub != pubs_.end() && *existing_pub == out.pub)
+    if (!pubs_.insert(out.pub).second)
       return false;
 
-    pubs_.insert(existing_pub, out.pub);
-    auto spendable_value = std::make_pair(out.spend_meta.id, out.recipient);
-    spendable_.insert(
-      std::lower_bound(spendable_.begin(), spendable_.end(), spendable_value),
-      spendable_value
-    );
+    spendable_.insert(std::make_pair(out.spend_meta.id, out.recipient));
     outputs_.push_back(out);
     return true;
   }
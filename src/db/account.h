@@ -26,8 +26,10 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
+#include <array>
 #include <boost/optional/optional.hpp>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
@@ -35,6 +37,7 @@
 #include "crypto/crypto.h"
 #include "fwd.h"
 #include "db/data.h"
+#include "db/flat_hash_set.h"
 #include "db/fwd.h"
 #include "wire/fwd.h"
 #include "wire/msgpack/fwd.h"
@@ -45,15 +48,48 @@ namespace lws
   class account
   {
     struct internal;
+    struct subaddresses;
 
+  public:
+    //! Hash and key for `db::output_id` lookups
+    struct spendable_traits
+    {
+      using value_type = std::pair<db::output_id, db::address_index>;
+
+      static db::output_id const& key(value_type const& value) noexcept { return value.first; }
+      static std::size_t hash(db::output_id const& id) noexcept
+      {
+        return std::size_t(id.low ^ (id.high * 0x9e3779b97f4a7c15));
+      }
+    };
+
+    //! Hash and key for `crypto::public_key` lookups
+    struct pub_traits
+    {
+      static crypto::public_key const& key(crypto::public_key const& value) noexcept { return value; }
+
+      //! Public keys are (effectively) random, so the leading bytes are the hash.
+      static std::size_t hash(crypto::public_key const& key) noexcept
+      {
+        std::size_t out = 0;
+        std::memcpy(std::addressof(out), std::addressof(key), sizeof(out));
+        return out;
+      }
+    };
+
+    using spendable_set = db::flat_hash_set<spendable_traits::value_type, spendable_traits>;
+    using pub_set = db::flat_hash_set<crypto::public_key, pub_traits>;
+
+  private:
     std::shared_ptr<const internal> immutable_;
-    std::vector<std::pair<db::output_id, db::address_index>> spendable_;
-    std::vector<crypto::public_key> pubs_;
+    std::shared_ptr<const subaddresses> subaddresses_;
+    spendable_set spendable_;
+    pub_set pubs_;
     std::vector<db::spend> spends_;
     std::vector<db::output> outputs_;
     db::block_id height_;
 
-    explicit account(std::shared_ptr<const internal> immutable, db::block_id height, std::vector<std::pair<db::output_id, db::address_index>> spendable, std::vector<crypto::public_key> pubs) noexcept;
+    explicit account(std::shared_ptr<const internal> immutable, db::block_id height, spendable_set spendable, pub_set pubs) noexcept;
     void null_check() const;
 
     template<typename F, typename T, typename U>
@@ -91,6 +127,14 @@ namespace lws
     //! \return A copy of `this` with a new height and `outputs().empty()`.
     void updated(db::block_id new_height) noexcept;
 
+    /*!
+      Move the outputs and spends of the latest scan into a new account that
+      shares the immutable info of `this`, but has no spendable outputs or
+      subaddresses. `this` is then `updated(new_height)`.
+
+      \return Account with the current scan height, for `db::storage::update`. */
+    account split_update(db::block_id new_height);
+
     //! \return Unique ID from the account database, possibly `db::account_id::kInvalid`.
     db::account_id id() const noexcept;
 
@@ -109,9 +153,27 @@ namespace lws
     //! \return Secret view key for the account.
     crypto::secret_key const& view_key() const;
 
+    //! \return `view_key()` recoded as signed radix-16 digits (-8..8), lowest first.
+    std::array<std::int8_t, 64> const& view_key_digits() const;
+
     //! \return Current scan height of `this`.
     db::block_id scan_height() const noexcept { return height_; }
 
+    //! \return Number of subaddress spend public keys tracked by `this`.
+    std::size_t subaddress_count() const noexcept;
+
+    /*!
+      Replace the subaddress spend public keys tracked by `this`. The keys are
+      not serialized by `write_bytes`, and must be set again after
+      de-serialization. */
+    void set_subaddresses(std::vector<db::subaddress_map> keys);
+
+    //! \return Subaddress index iff `spend_public` is tracked by `this`.
+    boost::optional<db::address_index> find_subaddress(crypto::public_key const& spend_public) const noexcept;
+
+    //! \return Outputs spendable by `this`, and their subaddress index.
+    spendable_set const& spendable() const noexcept { return spendable_; }
+
     //! \return Subaddress index iff `id` is spendable by `this`.
     boost::optional<db::address_index> get_spendable(db::output_id const& id) const noexcept;
 
@@ -34,6 +34,7 @@
 #include "int-util.h"          // monero/contribe/epee/include
 #include "ringct/rctOps.h"     // monero/src
 #include "ringct/rctTypes.h"   // monero/src
+#include "span.h"              // monero/contrib/epee/include
 #include "wire.h"
 #include "wire/adapted/array.h"
 #include "wire/adapted/crypto.h"
@@ -240,6 +241,51 @@ namespace db
   }
   WIRE_DEFINE_OBJECT(block_pow, map_block_pow);
 
+  namespace
+  {
+    //! Same limits as `get_blocks_fast` responses from the daemon
+    using max_scan_index_txes = wire::max_element_count<21845>;
+    using max_scan_index_outputs = wire::max_element_count<2000>;
+  }
+
+  void read_bytes(wire::reader& source, scan_index_tx& self)
+  {
+    std::vector<std::uint8_t> base;
+    wire::object(source,
+      wire::field<0>("hash", std::ref(self.hash)),
+      wire::field<1>("base", std::ref(base)),
+      wire::field<2>("output_indices", wire::array<max_scan_index_outputs>(std::ref(self.output_indices)))
+    );
+    self.base.assign(reinterpret_cast<const char*>(base.data()), base.size());
+  }
+
+  void write_bytes(wire::writer& dest, const scan_index_tx& self)
+  {
+    wire::object(dest,
+      wire::field<0>("hash", std::cref(self.hash)),
+      wire::field<1>("base", epee::strspan<std::uint8_t>(self.base)),
+      wire::field<2>("output_indices", std::cref(self.output_indices))
+    );
+  }
+
+  namespace
+  {
+    template<typename F, typename T>
+    void map_scan_index_block(F& format, T& self)
+    {
+      wire::object(format,
+        WIRE_FIELD_ID(0, height),
+        WIRE_FIELD_ID(1, hash),
+        WIRE_FIELD_ID(2, prev_id),
+        WIRE_FIELD_ID(3, timestamp),
+        WIRE_FIELD_ID(4, major_version),
+        WIRE_FIELD_ID(5, minor_version),
+        wire::field<6>("txes", wire::array<max_scan_index_txes>(std::ref(self.txes)))
+      );
+    }
+  }
+  WIRE_DEFINE_OBJECT(scan_index_block, map_scan_index_block);
+
   namespace
   {
     template<typename F, typename T>
@@ -225,6 +225,29 @@ namespace db
     block_difficulty cumulative_diff;
   };
 
+  //! Pruned transaction stored in the optional scan index
+  struct scan_index_tx
+  {
+    crypto::hash hash;  //!< Hash of the full transaction, not recomputable from `base`
+    std::string base;   //!< Binary `cryptonote::transaction` prefix and ringct base
+    std::vector<std::uint64_t> output_indices; //!< Global output indices
+  };
+  void read_bytes(wire::reader&, scan_index_tx&);
+  void write_bytes(wire::writer&, const scan_index_tx&);
+
+  //! Block stored in the optional scan index, enough to re-scan without a daemon
+  struct scan_index_block
+  {
+    block_id height;
+    crypto::hash hash;
+    crypto::hash prev_id;
+    std::uint64_t timestamp;
+    std::uint8_t major_version;
+    std::uint8_t minor_version;
+    std::vector<scan_index_tx> txes; //!< Miner transaction is first
+  };
+  WIRE_DECLARE_OBJECT(scan_index_block);
+
   //! `output`s and `spend`s are sorted by these fields to make merging easier.
   struct transaction_link
   {
@@ -294,6 +317,27 @@ namespace db
   void read_bytes(wire::reader&, output&);
   void write_bytes(wire::writer&, const output&);
 
+  //! Compact copy of `output` fields needed to resume scanning an account.
+  struct spendable_output
+  {
+    block_id height;         //!< Must be first for LMDB optimizations
+    output_id id;
+    address_index recipient;
+    crypto::public_key pub;  //!< One-time spendable public key.
+  };
+  static_assert(sizeof(spendable_output) == 8 + 8 * 2 + 4 * 2 + 32, "padding in spendable_output");
+
+  //! Running totals of `output`s and `spend`s for one account.
+  struct account_totals
+  {
+    std::uint64_t received;  //!< Sum of every received amount
+    std::uint64_t sent;      //!< Sum of received amounts, once per possible `spend`
+    std::uint64_t outputs;   //!< Number of received outputs
+    std::uint64_t spends;    //!< Number of possible spends
+    block_id locked_height;  //!< Outputs received below this height are unlocked
+  };
+  static_assert(sizeof(account_totals) == 8 * 5, "padding in account_totals");
+
   //! Information about a possible spend of a received `output`.
   struct spend
   {
@@ -0,0 +1,142 @@
+// Copyright (c) 2024, The Monero Project
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace lws
+{
+namespace db
+{
+  /*!
+    Open addressing (linear probe) hash set with values stored contiguously
+    in insertion order. Inserts are amortized O(1) and preserve insertion
+    order, but like `std::vector` any growth of the value storage
+    invalidates references and pointers to existing values. Values cannot
+    be removed, except with `clear()`.
+
+    `Traits::key(value)` must return the lookup key of a value, and
+    `Traits::hash(key)` must return its hash. Satisfies the `wire` array
+    concept for sorted containers (`emplace_hint`), so the serialized form is
+    identical to a `std::vector<T>`. */
+  template<typename T, typename Traits>
+  class flat_hash_set
+  {
+    std::vector<T> values_;
+    std::vector<std::uint32_t> slots_; //!< `values_` position + 1, or 0 if empty
+    std::size_t mask_;
+
+    void rehash(const std::size_t count)
+    {
+      std::size_t size = 16;
+      while (size < count * 2)
+        size <<= 1;
+      if (size <= slots_.size())
+        return;
+
+      slots_.assign(size, 0);
+      mask_ = size - 1;
+      for (std::size_t i = 0; i < values_.size(); ++i)
+        slots_[first_empty(Traits::key(values_[i]))] = std::uint32_t(i + 1);
+    }
+
+    template<typename K>
+    std::size_t first_empty(const K& key) const noexcept
+    {
+      std::size_t slot = Traits::hash(key) & mask_;
+      while (slots_[slot])
+        slot = (slot + 1) & mask_;
+      return slot;
+    }
+
+  public:
+    using value_type = T;
+    using const_iterator = typename std::vector<T>::const_iterator;
+    using iterator = const_iterator;
+
+    flat_hash_set()
+      : values_(), slots_(), mask_(0)
+    {}
+
+    const_iterator begin() const noexcept { return values_.begin(); }
+    const_iterator end() const noexcept { return values_.end(); }
+    std::size_t size() const noexcept { return values_.size(); }
+    bool empty() const noexcept { return values_.empty(); }
+
+    void clear() noexcept
+    {
+      values_.clear();
+      slots_.clear();
+      mask_ = 0;
+    }
+
+    void reserve(const std::size_t count)
+    {
+      values_.reserve(count);
+      rehash(count);
+    }
+
+    //! \return Value matching `key`, or `nullptr`.
+    template<typename K>
+    const T* find(const K& key) const noexcept
+    {
+      if (slots_.empty())
+        return nullptr;
+      for (std::size_t slot = Traits::hash(key) & mask_; slots_[slot]; slot = (slot + 1) & mask_)
+      {
+        const T& value = values_[slots_[slot] - 1];
+        if (Traits::key(value) == key)
+          return std::addressof(value);
+      }
+      return nullptr;
+    }
+
+    //! \return Position of `value` and true, or position of existing value with same key and false.
+    std::pair<const_iterator, bool> insert(T value)
+    {
+      const T* const existing = find(Traits::key(value));
+      if (existing)
+        return {values_.begin() + (existing - values_.data()), false};
+
+      rehash(values_.size() + 1);
+      slots_[first_empty(Traits::key(value))] = std::uint32_t(values_.size() + 1);
+      values_.push_back(std::move(value));
+      return {values_.end() - 1, true};
+    }
+
+    //! Same as `insert`, `hint` is ignored.
+    const_iterator emplace_hint(const_iterator, T value)
+    {
+      return insert(std::move(value)).first;
+    }
+  };
+} // db
+} // lws
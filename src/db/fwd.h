@@ -53,6 +53,7 @@ namespace db
   struct key_image;
   struct output;
   struct output_id;
+  struct pow_window;
   struct request_info;
   struct spend;
   class storage;
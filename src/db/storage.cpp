@@ -33,16 +33,23 @@
 #include <boost/range/counting_range.hpp>
 #include <boost/range/iterator_range.hpp>
 #include <boost/uuid/uuid_hash.hpp>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <limits>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 
 #include "checkpoints/checkpoints.h"
 #include "config.h"
 #include "crypto/crypto.h"
 #include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_config.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
 #include "db/account.h"
 #include "db/string.h"
@@ -294,6 +301,26 @@ namespace db
       return less<output_id>(left_bytes, right_bytes);
     }
 
+    int spendable_compare(MDB_val const* left, MDB_val const* right) noexcept
+    {
+      if (left == nullptr || right == nullptr)
+      {
+        assert("MDB_val nullptr" == 0);
+        return -1;
+      }
+
+      auto left_bytes = lmdb::to_byte_span(*left);
+      auto right_bytes = lmdb::to_byte_span(*right);
+
+      const int diff = less<lmdb::native_type<block_id>>(left_bytes, right_bytes);
+      if (diff)
+        return diff;
+
+      left_bytes.remove_prefix(sizeof(block_id));
+      right_bytes.remove_prefix(sizeof(block_id));
+      return less<output_id>(left_bytes, right_bytes);
+    }
+
     constexpr const lmdb::basic_table<unsigned, block_info> blocks{
       "blocks_by_id", (MDB_CREATE | MDB_DUPSORT), MONERO_SORT_BY(block_info, id)
     };
@@ -318,6 +345,12 @@ namespace db
     constexpr const lmdb::basic_table<account_id, output> outputs{
       "outputs_v2_by_account_id,block_id,tx_hash,output_id", (MDB_CREATE | MDB_DUPSORT), &output_compare
     };
+    constexpr const lmdb::basic_table<account_id, spendable_output> spendables{
+      "spendables_by_account_id,block_id,output_id", (MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED), &spendable_compare
+    };
+    constexpr const lmdb::basic_table<account_id, account_totals> totals{
+      "totals_by_account_id", MDB_CREATE, nullptr
+    };
     constexpr const lmdb::basic_table<account_id, v0::spend> spends_v0{
       "spends_by_account_id,block_id,tx_hash,image", MDB_DUPSORT, &spend_compare
     };
@@ -342,6 +375,9 @@ namespace db
     constexpr const lmdb::basic_table<account_id, subaddress_map> subaddress_indexes{
       "subaddress_indexes_by_account_id,public_key", (MDB_CREATE | MDB_DUPSORT), MONERO_COMPARE(subaddress_map, subaddress)
     };
+    constexpr const lmdb::table scan_index{
+      "scan_index_by_block_id", MDB_CREATE, &lmdb::less<lmdb::native_type<block_id>>, nullptr
+    };
 
     template<typename D>
     expect<void> check_cursor(MDB_txn& txn, MDB_dbi tbl, std::unique_ptr<MDB_cursor, D>& cur) noexcept
@@ -360,8 +396,16 @@ namespace db
       return success();
     }
 
-    template<typename K, typename V>
-    expect<void> bulk_insert(MDB_cursor& cur, K const& key, epee::span<V> values, unsigned flags = MDB_NODUPDATA) noexcept
+    struct ignore_duplicate
+    {
+      template<typename V>
+      void operator()(const V&) const noexcept
+      {}
+    };
+
+    //! `on_duplicate` is invoked with every value skipped due to `MDB_KEYEXIST`.
+    template<typename K, typename V, typename F = ignore_duplicate>
+    expect<void> bulk_insert(MDB_cursor& cur, K const& key, epee::span<V> values, unsigned flags = MDB_NODUPDATA, F on_duplicate = {}) noexcept
     {
       while (!values.empty())
       {
@@ -377,6 +421,8 @@ namespace db
         if (err && err != MDB_KEYEXIST)
           return {lmdb::error(err)};
 
+        if (err == MDB_KEYEXIST)
+          on_duplicate(values[value_bytes[1].mv_size]);
         values.remove_prefix(value_bytes[1].mv_size + (err == MDB_KEYEXIST ? 1 : 0));
       }
       return success();
@@ -422,6 +468,279 @@ namespace db
       }
     }
 
+    spendable_output make_spendable(const output& source) noexcept
+    {
+      return {source.link.height, source.spend_meta.id, source.recipient, source.pub};
+    }
+
+    //! Copy `outputs` into `spendables` when opening an older database
+    expect<void> fill_spendables(MDB_txn& txn, MDB_dbi outputs_tbl, MDB_dbi spendables_tbl)
+    {
+      MDB_stat stats{};
+      MONERO_LMDB_CHECK(mdb_stat(&txn, spendables_tbl, &stats));
+      if (stats.ms_entries)
+        return success();
+      MONERO_LMDB_CHECK(mdb_stat(&txn, outputs_tbl, &stats));
+      if (!stats.ms_entries)
+        return success();
+
+      MINFO("DB update: copying " << stats.ms_entries << " outputs to spendables table");
+
+      cursor::outputs outputs_cur;
+      cursor::spendables spendables_cur;
+      MONERO_CHECK(check_cursor(txn, outputs_tbl, outputs_cur));
+      MONERO_CHECK(check_cursor(txn, spendables_tbl, spendables_cur));
+
+      MDB_val key{};
+      MDB_val value{};
+      int err = mdb_cursor_get(outputs_cur.get(), &key, &value, MDB_FIRST);
+      for ( ; !err; err = mdb_cursor_get(outputs_cur.get(), &key, &value, MDB_NEXT))
+      {
+        const expect<output> source = outputs.get_value<output>(value);
+        if (!source)
+          return source.error();
+
+        const spendable_output row = make_spendable(*source);
+        MDB_val row_value = lmdb::to_val(row);
+        err = mdb_cursor_put(spendables_cur.get(), &key, &row_value, MDB_NODUPDATA);
+        if (err && err != MDB_KEYEXIST)
+          return {lmdb::error(err)};
+      }
+      if (err != MDB_NOTFOUND)
+        return {lmdb::error(err)};
+      return success();
+    }
+
+    //! \return True if `unlock_time` has passed at `height`. Mirrors REST API.
+    bool is_unlocked(const std::uint64_t unlock_time, const block_id height) noexcept
+    {
+      if (unlock_time > CRYPTONOTE_MAX_BLOCK_NUMBER)
+        return std::chrono::seconds{unlock_time} <= std::chrono::system_clock::now().time_since_epoch();
+      return block_id(unlock_time) <= height;
+    }
+
+    /*!
+      \param sources Sorted and unique.
+      \return `spend_meta` of every output in `sources` received by `user`,
+        sorted by output id. The compact `spendables` table locates the
+        height of each source, so only matching `output`s are read. */
+    expect<std::vector<output::spend_meta_>> find_spend_metas(MDB_cursor& spendables_cur, MDB_cursor& outputs_cur, const account_id user, const epee::span<const output_id> sources)
+    {
+      std::vector<output::spend_meta_> out{};
+      if (sources.empty())
+        return {std::move(out)};
+
+      MDB_val key = lmdb::to_val(user);
+      MDB_val value{};
+      int err = mdb_cursor_get(&spendables_cur, &key, &value, MDB_SET);
+      if (err == MDB_NOTFOUND)
+        return {std::move(out)};
+      if (err)
+        return {lmdb::error(err)};
+
+      std::vector<spendable_output> located{};
+      located.reserve(sources.size());
+
+      // `MDB_DUPFIXED` returns a page of values per call
+      err = mdb_cursor_get(&spendables_cur, &key, &value, MDB_GET_MULTIPLE);
+      for ( ; !err; err = mdb_cursor_get(&spendables_cur, &key, &value, MDB_NEXT_MULTIPLE))
+      {
+        if (value.mv_size % sizeof(spendable_output))
+          return {lmdb::error(MDB_CORRUPTED)};
+
+        const char* const page = static_cast<const char*>(value.mv_data);
+        for (std::size_t offset = 0; offset < value.mv_size; offset += sizeof(spendable_output))
+        {
+          spendable_output row;
+          std::memcpy(std::addressof(row), page + offset, sizeof(row));
+          if (std::binary_search(sources.begin(), sources.end(), row.id))
+            located.push_back(row);
+        }
+      }
+      if (err != MDB_NOTFOUND)
+        return {lmdb::error(err)};
+
+      out.reserve(located.size());
+      for (const spendable_output& source : located)
+      {
+        key = lmdb::to_val(user);
+        value = lmdb::to_val(source.height);
+        err = mdb_cursor_get(&outputs_cur, &key, &value, MDB_GET_BOTH_RANGE);
+        for ( ; !err; err = mdb_cursor_get(&outputs_cur, &key, &value, MDB_NEXT_DUP))
+        {
+          const expect<transaction_link> link = outputs.get_value<MONERO_FIELD(output, link)>(value);
+          if (!link)
+            return link.error();
+          if (link->height != source.height)
+            break;
+
+          const expect<output::spend_meta_> meta =
+            outputs.get_value<MONERO_FIELD(output, spend_meta)>(value);
+          if (!meta)
+            return meta.error();
+          if (meta->id == source.id)
+          {
+            out.push_back(*meta);
+            break;
+          }
+        }
+        if (err && err != MDB_NOTFOUND)
+          return {lmdb::error(err)};
+      }
+
+      std::sort(out.begin(), out.end(), [] (const output::spend_meta_& left, const output::spend_meta_& right)
+      {
+        return left.id < right.id;
+      });
+      return {std::move(out)};
+    }
+
+    //! \return Totals for `user` by reading every output and spend.
+    expect<account_totals> compute_totals(MDB_cursor& outputs_cur, MDB_cursor& spends_cur, const account_id user)
+    {
+      account_totals out{};
+      std::vector<std::pair<output_id, std::uint64_t>> amounts{};
+
+      const auto by_id = [] (const std::pair<output_id, std::uint64_t>& left, const output_id& right)
+      {
+        return left.first < right;
+      };
+
+      MDB_val key = lmdb::to_val(user);
+      MDB_val value{};
+      int err = mdb_cursor_get(&outputs_cur, &key, &value, MDB_SET);
+      for ( ; !err; err = mdb_cursor_get(&outputs_cur, &key, &value, MDB_NEXT_DUP))
+      {
+        const expect<output::spend_meta_> meta =
+          outputs.get_value<MONERO_FIELD(output, spend_meta)>(value);
+        if (!meta)
+          return meta.error();
+
+        amounts.emplace_back(meta->id, meta->amount);
+        out.received += meta->amount;
+        ++out.outputs;
+      }
+      if (err != MDB_NOTFOUND)
+        return {lmdb::error(err)};
+
+      std::sort(amounts.begin(), amounts.end(), [] (const std::pair<output_id, std::uint64_t>& left, const std::pair<output_id, std::uint64_t>& right)
+      {
+        return left.first < right.first;
+      });
+
+      key = lmdb::to_val(user);
+      err = mdb_cursor_get(&spends_cur, &key, &value, MDB_SET);
+      for ( ; !err; err = mdb_cursor_get(&spends_cur, &key, &value, MDB_NEXT_DUP))
+      {
+        const expect<output_id> source = spends.get_value<MONERO_FIELD(spend, source)>(value);
+        if (!source)
+          return source.error();
+
+        const auto amount = std::lower_bound(amounts.begin(), amounts.end(), *source, by_id);
+        if (amount != amounts.end() && amount->first == *source)
+          out.sent += amount->second;
+        ++out.spends;
+      }
+      if (err != MDB_NOTFOUND)
+        return {lmdb::error(err)};
+
+      out.locked_height = block_id(0); // re-checked on next `storage::update`
+      return {out};
+    }
+
+    //! \return Stored totals for `user`, or zeroes if never stored.
+    expect<account_totals> read_totals(MDB_cursor& totals_cur, const account_id user) noexcept
+    {
+      MDB_val key = lmdb::to_val(user);
+      MDB_val value{};
+      const int err = mdb_cursor_get(&totals_cur, &key, &value, MDB_SET_KEY);
+      if (err == MDB_NOTFOUND)
+        return {account_totals{}};
+      if (err)
+        return {lmdb::error(err)};
+      return totals.get_value<account_totals>(value);
+    }
+
+    expect<void> put_totals(MDB_cursor& totals_cur, const account_id user, const account_totals& sums) noexcept
+    {
+      MDB_val key = lmdb::to_val(user);
+      MDB_val value = lmdb::to_val(sums);
+      MONERO_LMDB_CHECK(mdb_cursor_put(&totals_cur, &key, &value, 0));
+      return success();
+    }
+
+    //! Move `sums.locked_height` past outputs of `user` that are unlocked at `height`.
+    expect<void> advance_locked(MDB_cursor& outputs_cur, const account_id user, account_totals& sums, const block_id height)
+    {
+      MDB_val key = lmdb::to_val(user);
+      MDB_val value = lmdb::to_val(sums.locked_height);
+      int err = mdb_cursor_get(&outputs_cur, &key, &value, MDB_GET_BOTH_RANGE);
+      for ( ; !err; err = mdb_cursor_get(&outputs_cur, &key, &value, MDB_NEXT_DUP))
+      {
+        const expect<std::uint64_t> unlock_time =
+          outputs.get_value<MONERO_FIELD(output, unlock_time)>(value);
+        if (!unlock_time)
+          return unlock_time.error();
+
+        if (!is_unlocked(*unlock_time, height))
+        {
+          const expect<transaction_link> link = outputs.get_value<MONERO_FIELD(output, link)>(value);
+          if (!link)
+            return link.error();
+          sums.locked_height = link->height;
+          return success();
+        }
+      }
+      if (err != MDB_NOTFOUND)
+        return {lmdb::error(err)};
+
+      sums.locked_height = std::max(sums.locked_height, block_id(lmdb::to_native(height) + 1));
+      return success();
+    }
+
+    //! Compute `totals` for every account with outputs when opening an older database
+    expect<void> fill_totals(MDB_txn& txn, MDB_dbi outputs_tbl, MDB_dbi spends_tbl, MDB_dbi totals_tbl)
+    {
+      MDB_stat stats{};
+      MONERO_LMDB_CHECK(mdb_stat(&txn, totals_tbl, &stats));
+      if (stats.ms_entries)
+        return success();
+      MONERO_LMDB_CHECK(mdb_stat(&txn, outputs_tbl, &stats));
+      if (!stats.ms_entries)
+        return success();
+
+      MINFO("DB update: computing account totals from " << stats.ms_entries << " outputs");
+
+      cursor::outputs accounts_cur;
+      cursor::outputs outputs_cur;
+      cursor::spends spends_cur;
+      cursor::totals totals_cur;
+      MONERO_CHECK(check_cursor(txn, outputs_tbl, accounts_cur));
+      MONERO_CHECK(check_cursor(txn, outputs_tbl, outputs_cur));
+      MONERO_CHECK(check_cursor(txn, spends_tbl, spends_cur));
+      MONERO_CHECK(check_cursor(txn, totals_tbl, totals_cur));
+
+      MDB_val key{};
+      MDB_val value{};
+      int err = mdb_cursor_get(accounts_cur.get(), &key, &value, MDB_FIRST);
+      for ( ; !err; err = mdb_cursor_get(accounts_cur.get(), &key, &value, MDB_NEXT_NODUP))
+      {
+        if (key.mv_size != sizeof(account_id))
+          return {lmdb::error(MDB_BAD_VALSIZE)};
+
+        account_id user{};
+        std::memcpy(std::addressof(user), key.mv_data, sizeof(user));
+
+        const expect<account_totals> sums = compute_totals(*outputs_cur, *spends_cur, user);
+        if (!sums)
+          return sums.error();
+        MONERO_CHECK(put_totals(*totals_cur, user, *sums));
+      }
+      if (err != MDB_NOTFOUND)
+        return {lmdb::error(err)};
+      return success();
+    }
+
     //! \return Current block hash at `id` using `cur`.
     expect<crypto::hash> do_get_block_hash(MDB_cursor& cur, block_id id) noexcept
     {
@@ -651,6 +970,40 @@ namespace db
       } while (err == 0);
       return {lmdb::error(err)};
     }
+
+    //! Same as `lmdb::open_environment`, except `opts` are applied.
+    expect<lmdb::environment> open_environment(const char* path, const storage_options& opts) noexcept
+    {
+      MONERO_PRECOND(path != nullptr);
+
+      unsigned flags = 0;
+      switch (opts.sync)
+      {
+      case storage_options::durability::no_meta_sync:
+        flags |= MDB_NOMETASYNC;
+        break;
+      case storage_options::durability::no_sync:
+        flags |= MDB_NOSYNC;
+        break;
+      case storage_options::durability::full:
+      default:
+        break;
+      }
+      if (opts.write_map)
+        flags |= MDB_WRITEMAP;
+      if (opts.no_read_ahead)
+        flags |= MDB_NORDAHEAD;
+
+      MDB_env* obj = nullptr;
+      MONERO_LMDB_CHECK(mdb_env_create(std::addressof(obj)));
+      lmdb::environment out{obj};
+
+      MONERO_LMDB_CHECK(mdb_env_set_maxdbs(out.get(), 20));
+      if (opts.map_size)
+        MONERO_LMDB_CHECK(mdb_env_set_mapsize(out.get(), opts.map_size));
+      MONERO_LMDB_CHECK(mdb_env_open(out.get(), path, flags, 0664));
+      return {std::move(out)};
+    }
   } // anonymous
 
   struct storage_internal : lmdb::database
@@ -663,6 +1016,7 @@ namespace db
       MDB_dbi accounts_ba;
       MDB_dbi accounts_bh;
       MDB_dbi outputs;
+      MDB_dbi spendables;
       MDB_dbi spends;
       MDB_dbi images;
       MDB_dbi requests;
@@ -670,12 +1024,57 @@ namespace db
       MDB_dbi events;
       MDB_dbi subaddress_ranges;
       MDB_dbi subaddress_indexes;
+      MDB_dbi scan_index;
+      MDB_dbi totals;
     } tables;
 
     const unsigned create_queue_max;
+    std::atomic<std::uint64_t> subaddress_version;
+    const bool nested_txns; //!< False with `MDB_WRITEMAP`
 
-    explicit storage_internal(lmdb::environment env, unsigned create_queue_max)
-      : lmdb::database(std::move(env)), tables{}, create_queue_max(create_queue_max)
+  private:
+    MDB_env* const handle;
+    std::mutex sync_lock;
+    std::condition_variable sync_stop;
+    bool stop;
+    std::thread syncer;
+
+    //! Flushes `MDB_NOSYNC`/`MDB_NOMETASYNC` commits every `interval`.
+    void sync_loop(const std::chrono::seconds interval) noexcept
+    {
+      std::unique_lock<std::mutex> lock{sync_lock};
+      while (!stop)
+      {
+        sync_stop.wait_for(lock, interval);
+
+        /* `mdb_env_sync` does not open a txn, but with `MDB_WRITEMAP` it
+          `msync`s the map. A read txn blocks `resize` from re-mapping it. */
+        const expect<lmdb::read_txn> guard = this->create_read_txn(nullptr);
+        if (!guard)
+        {
+          MWARNING("Skipping background LMDB sync: " << guard.error().message());
+          continue;
+        }
+
+        const int err = mdb_env_sync(handle, 1);
+        if (err)
+          MERROR("Background LMDB sync failed: " << lmdb::error(err).message());
+      }
+    }
+
+  public:
+    //! \param handle Same as `env.get()`, which is moved into the base first.
+    explicit storage_internal(lmdb::environment env, MDB_env* handle, unsigned create_queue_max, const storage_options& opts)
+      : lmdb::database(std::move(env)),
+        tables{},
+        create_queue_max(create_queue_max),
+        subaddress_version(0),
+        nested_txns(!opts.write_map),
+        handle(handle),
+        sync_lock(),
+        sync_stop(),
+        stop(false),
+        syncer()
     {
       lmdb::write_txn txn = this->create_write_txn().value();
       assert(txn != nullptr);
@@ -686,6 +1085,7 @@ namespace db
       tables.accounts_ba = accounts_by_address.open(*txn).value();
       tables.accounts_bh = accounts_by_height.open(*txn).value();
       tables.outputs     = outputs.open(*txn).value();
+      tables.spendables  = spendables.open(*txn).value();
       tables.spends      = spends.open(*txn).value();
       tables.images      = images.open(*txn).value();
       tables.requests    = requests.open(*txn).value();
@@ -693,6 +1093,8 @@ namespace db
       tables.events      = events_by_account_id.open(*txn).value();
       tables.subaddress_ranges  = subaddress_ranges.open(*txn).value();
       tables.subaddress_indexes = subaddress_indexes.open(*txn).value(); 
+      tables.scan_index  = scan_index.open(*txn).value();
+      tables.totals      = totals.open(*txn).value();
 
       const auto v0_outputs = outputs_v0.open(*txn);
       if (v0_outputs)
@@ -706,15 +1108,42 @@ namespace db
       else if (v1_outputs != lmdb::error(MDB_NOTFOUND))
         MONERO_THROW(v1_outputs.error(), "Error opening old outputs table");
 
+      MONERO_UNWRAP(fill_spendables(*txn, tables.outputs, tables.spendables));
+
       const auto v0_spends = spends_v0.open(*txn);
       if (v0_spends)
         MONERO_UNWRAP(convert_table<v0::spend, spend>(*txn, *v0_spends, tables.spends));
       else if (v0_spends != lmdb::error(MDB_NOTFOUND))
         MONERO_THROW(v0_spends.error(), "Error opening old spends table");
 
+      MONERO_UNWRAP(fill_totals(*txn, tables.outputs, tables.spends, tables.totals));
+
       check_blockchain(*txn, tables.blocks);
       check_pow(*txn, tables.pows);
       MONERO_UNWRAP(this->commit(std::move(txn)));
+
+      if (opts.sync != storage_options::durability::full)
+      {
+        const std::chrono::seconds interval = std::max(std::chrono::seconds{1}, opts.sync_interval);
+        syncer = std::thread{[this, interval] () { sync_loop(interval); }};
+      }
+    }
+
+    storage_internal(const storage_internal&) = delete;
+    storage_internal& operator=(const storage_internal&) = delete;
+
+    //! Flushes unsynced commits before the environment is closed.
+    ~storage_internal() noexcept
+    {
+      if (syncer.joinable())
+      {
+        {
+          const std::lock_guard<std::mutex> lock{sync_lock};
+          stop = true;
+        }
+        sync_stop.notify_all();
+        syncer.join();
+      }
     }
   };
 
@@ -762,6 +1191,66 @@ namespace db
     return do_get_block_hash(*curs.blocks_cur, height);
   }
 
+  expect<std::vector<scan_index_block>> storage_reader::get_scan_index(const block_id start, const std::size_t max)
+  {
+    MONERO_PRECOND(txn != nullptr);
+    assert(db != nullptr);
+
+    cursor::scan_index index_cur;
+    MONERO_CHECK(check_cursor(*txn, db->tables.scan_index, index_cur));
+    MONERO_CHECK(check_cursor(*txn, db->tables.blocks, curs.blocks_cur));
+
+    std::vector<scan_index_block> out{};
+    for (std::uint64_t height = std::uint64_t(start); out.size() < max; ++height)
+    {
+      MDB_val key = lmdb::to_val(height);
+      MDB_val value{};
+      const int err = mdb_cursor_get(index_cur.get(), &key, &value, MDB_SET);
+      if (err)
+      {
+        if (err == MDB_NOTFOUND)
+          break;
+        return {lmdb::error(err)};
+      }
+
+      scan_index_block block{};
+      const std::error_code error =
+        wire::msgpack::from_bytes(epee::byte_slice{{lmdb::to_byte_span(value)}}, block);
+      if (error)
+        return error;
+
+      // rollbacks remove index blocks, but be certain
+      const expect<crypto::hash> hash = do_get_block_hash(*curs.blocks_cur, block_id(height));
+      if (!hash || *hash != block.hash || block.height != block_id(height))
+        break;
+
+      out.push_back(std::move(block));
+    }
+    return out;
+  }
+
+  expect<bool> storage_reader::has_scan_index(const block_id first, const block_id last) noexcept
+  {
+    MONERO_PRECOND(txn != nullptr);
+    assert(db != nullptr);
+
+    cursor::scan_index index_cur;
+    MONERO_CHECK(check_cursor(*txn, db->tables.scan_index, index_cur));
+
+    // a failed commit cannot leave a gap, but older databases may have one
+    for (std::uint64_t height = std::uint64_t(first); height <= std::uint64_t(last); ++height)
+    {
+      MDB_val key = lmdb::to_val(height);
+      MDB_val value{};
+      const int err = mdb_cursor_get(index_cur.get(), &key, &value, MDB_SET);
+      if (err == MDB_NOTFOUND)
+        return false;
+      if (err)
+        return {lmdb::error(err)};
+    }
+    return true;
+  }
+
   expect<std::list<crypto::hash>> storage_reader::get_chain_sync()
   {
     MONERO_PRECOND(txn != nullptr);
@@ -944,6 +1433,42 @@ namespace db
     return outputs.get_value_stream(id, std::move(cur));
   }
 
+  expect<std::vector<spendable_output>>
+  storage_reader::get_spendables(const account_id id, cursor::spendables cur)
+  {
+    MONERO_PRECOND(txn != nullptr);
+    assert(db != nullptr);
+    MONERO_CHECK(check_cursor(*txn, db->tables.spendables, cur));
+
+    MDB_val key = lmdb::to_val(id);
+    MDB_val value{};
+    std::vector<spendable_output> out{};
+    int err = mdb_cursor_get(cur.get(), &key, &value, MDB_SET);
+    if (err == MDB_NOTFOUND)
+      return {std::move(out)};
+    if (err)
+      return {lmdb::error(err)};
+
+    mdb_size_t count = 0;
+    MONERO_LMDB_CHECK(mdb_cursor_count(cur.get(), &count));
+    out.reserve(count);
+
+    // `MDB_DUPFIXED` returns a page of values per call
+    err = mdb_cursor_get(cur.get(), &key, &value, MDB_GET_MULTIPLE);
+    for ( ; !err; err = mdb_cursor_get(cur.get(), &key, &value, MDB_NEXT_MULTIPLE))
+    {
+      if (value.mv_size % sizeof(spendable_output))
+        return {lmdb::error(MDB_CORRUPTED)};
+
+      const std::size_t current = out.size();
+      out.resize(current + value.mv_size / sizeof(spendable_output));
+      std::memcpy(out.data() + current, value.mv_data, value.mv_size);
+    }
+    if (err != MDB_NOTFOUND)
+      return {lmdb::error(err)};
+    return {std::move(out)};
+  }
+
   expect<lmdb::value_stream<spend, cursor::close_spends>>
   storage_reader::get_spends(account_id id, cursor::spends cur) noexcept
   {
@@ -953,6 +1478,95 @@ namespace db
     return spends.get_value_stream(id, std::move(cur));
   }
 
+  expect<account_totals> storage_reader::get_totals(const account_id id, cursor::totals cur) noexcept
+  {
+    MONERO_PRECOND(txn != nullptr);
+    assert(db != nullptr);
+    MONERO_CHECK(check_cursor(*txn, db->tables.totals, cur));
+    return read_totals(*cur, id);
+  }
+
+  expect<height_range<output>> storage_reader::get_outputs(
+    const account_id id, const block_id first, const block_id last, const std::size_t max, cursor::outputs cur)
+  {
+    MONERO_PRECOND(txn != nullptr);
+    assert(db != nullptr);
+    MONERO_CHECK(check_cursor(*txn, db->tables.outputs, cur));
+
+    height_range<output> out{{}, false};
+    MDB_val key = lmdb::to_val(id);
+    MDB_val value = lmdb::to_val(first);
+    int err = mdb_cursor_get(cur.get(), &key, &value, MDB_GET_BOTH_RANGE);
+    for ( ; !err; err = mdb_cursor_get(cur.get(), &key, &value, MDB_NEXT_DUP))
+    {
+      const expect<transaction_link> link = outputs.get_value<MONERO_FIELD(output, link)>(value);
+      if (!link)
+        return link.error();
+      if (last < link->height)
+        break;
+      if (!out.values.empty() && max <= out.values.size() && out.values.back().link.height != link->height)
+      {
+        out.more = true;
+        break;
+      }
+
+      const expect<output> next = outputs.get_value<output>(value);
+      if (!next)
+        return next.error();
+      out.values.push_back(*next);
+    }
+    if (err && err != MDB_NOTFOUND)
+      return {lmdb::error(err)};
+    return {std::move(out)};
+  }
+
+  expect<height_range<spend>> storage_reader::get_spends(
+    const account_id id, const block_id first, const block_id last, const std::size_t max, cursor::spends cur)
+  {
+    MONERO_PRECOND(txn != nullptr);
+    assert(db != nullptr);
+    MONERO_CHECK(check_cursor(*txn, db->tables.spends, cur));
+
+    height_range<spend> out{{}, false};
+    MDB_val key = lmdb::to_val(id);
+    MDB_val value = lmdb::to_val(first);
+    int err = mdb_cursor_get(cur.get(), &key, &value, MDB_GET_BOTH_RANGE);
+    for ( ; !err; err = mdb_cursor_get(cur.get(), &key, &value, MDB_NEXT_DUP))
+    {
+      const expect<transaction_link> link = spends.get_value<MONERO_FIELD(spend, link)>(value);
+      if (!link)
+        return link.error();
+      if (last < link->height)
+        break;
+      if (!out.values.empty() && max <= out.values.size() && out.values.back().link.height != link->height)
+      {
+        out.more = true;
+        break;
+      }
+
+      const expect<spend> next = spends.get_value<spend>(value);
+      if (!next)
+        return next.error();
+      out.values.push_back(*next);
+    }
+    if (err && err != MDB_NOTFOUND)
+      return {lmdb::error(err)};
+    return {std::move(out)};
+  }
+
+  expect<std::vector<output::spend_meta_>>
+  storage_reader::get_spend_metas(const account_id id, const epee::span<const output_id> sources)
+  {
+    MONERO_PRECOND(txn != nullptr);
+    assert(db != nullptr);
+
+    cursor::spendables spendables_cur;
+    cursor::outputs outputs_cur;
+    MONERO_CHECK(check_cursor(*txn, db->tables.spendables, spendables_cur));
+    MONERO_CHECK(check_cursor(*txn, db->tables.outputs, outputs_cur));
+    return find_spend_metas(*spendables_cur, *outputs_cur, id, sources);
+  }
+
   expect<lmdb::value_stream<db::key_image, cursor::close_images>>
   storage_reader::get_images(output_id id, cursor::images cur) noexcept
   {
@@ -962,6 +1576,43 @@ namespace db
     return images.get_value_stream(id, std::move(cur));
   }
 
+  expect<std::vector<std::pair<output_id, crypto::key_image>>>
+  storage_reader::get_images(const account_id id, cursor::spends cur)
+  {
+    MONERO_PRECOND(txn != nullptr);
+    assert(db != nullptr);
+    MONERO_CHECK(check_cursor(*txn, db->tables.spends, cur));
+
+    // `images` is only written by `add_spends`, keyed by `spend::source`
+    std::vector<std::pair<output_id, crypto::key_image>> out{};
+    MDB_val key = lmdb::to_val(id);
+    MDB_val value{};
+    int err = mdb_cursor_get(cur.get(), &key, &value, MDB_SET);
+    for ( ; !err; err = mdb_cursor_get(cur.get(), &key, &value, MDB_NEXT_DUP))
+    {
+      const expect<output_id> source = spends.get_value<MONERO_FIELD(spend, source)>(value);
+      if (!source)
+        return source.error();
+      const expect<crypto::key_image> image = spends.get_value<MONERO_FIELD(spend, image)>(value);
+      if (!image)
+        return image.error();
+      out.emplace_back(*source, *image);
+    }
+    if (err != MDB_NOTFOUND)
+      return {lmdb::error(err)};
+
+    // same order and uniqueness as `images` table
+    const auto by_image = [] (const auto& left, const auto& right)
+    {
+      if (left.first == right.first)
+        return std::memcmp(std::addressof(left.second), std::addressof(right.second), sizeof(left.second)) < 0;
+      return left.first < right.first;
+    };
+    std::sort(out.begin(), out.end(), by_image);
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return {std::move(out)};
+  }
+
   expect<lmdb::key_stream<request, request_info, cursor::close_requests>>
   storage_reader::get_requests(cursor::requests cur) noexcept
   {
@@ -1017,6 +1668,15 @@ namespace db
     return {std::move(ranges)};
   }
 
+  expect<lmdb::value_stream<subaddress_map, cursor::close_subaddress_indexes>>
+  storage_reader::get_subaddress_indexes(account_id id, cursor::subaddress_indexes cur) noexcept
+  {
+    MONERO_PRECOND(txn != nullptr);
+    assert(db != nullptr);
+    MONERO_CHECK(check_cursor(*txn, db->tables.subaddress_indexes, cur));
+    return subaddress_indexes.get_value_stream(id, std::move(cur));
+  }
+
   expect<address_index>
   storage_reader::find_subaddress(account_id id, crypto::public_key const& address, cursor::subaddress_indexes& cur) noexcept
   {
@@ -1364,12 +2024,12 @@ namespace db
     return block_info{block_id(last->first), last->second};
   } 
 
-  storage storage::open(const char* path, unsigned create_queue_max)
+  storage storage::open(const char* path, unsigned create_queue_max, const storage_options& opts)
   {
+    lmdb::environment env = MONERO_UNWRAP(open_environment(path, opts));
+    MDB_env* const handle = env.get();
     return {
-      std::make_shared<storage_internal>(
-        MONERO_UNWRAP(lmdb::open_environment(path, 20)), create_queue_max
-      )
+      std::make_shared<storage_internal>(std::move(env), handle, create_queue_max, opts)
     };
   }
 
@@ -1381,6 +2041,13 @@ namespace db
     return storage{db};
   }
 
+  std::uint64_t storage::subaddress_version() const noexcept
+  {
+    if (!db)
+      return 0;
+    return db->subaddress_version;
+  }
+
   expect<storage_reader> storage::start_read(lmdb::suspended_txn txn) const
   {
     MONERO_PRECOND(db != nullptr);
@@ -1395,8 +2062,9 @@ namespace db
 
   namespace // sub functions for `sync_chain(...)`
   {
+    //! Appends `spend::source` of every removed spend to `removed`.
     expect<void>
-    rollback_spends(account_id user, block_id height, MDB_cursor& spends_cur, MDB_cursor& images_cur) noexcept
+    rollback_spends(account_id user, block_id height, MDB_cursor& spends_cur, MDB_cursor& images_cur, std::vector<output_id>& removed)
     {
       MDB_val key = lmdb::to_val(user);
       MDB_val value = lmdb::to_val(height);
@@ -1412,6 +2080,7 @@ namespace db
         const expect<output_id> out = spends.get_value<MONERO_FIELD(spend, source)>(value);
         if (!out)
           return out.error();
+        removed.push_back(*out);
 
         const expect<crypto::key_image> image =
           spends.get_value<MONERO_FIELD(spend, image)>(value);
@@ -1433,8 +2102,11 @@ namespace db
       return success();
     }
 
+    /*! Also used for `spendables`, which has the same ordering by height.
+      Removed outputs are subtracted from `sums`, iff not `nullptr` (only
+      valid for `outputs` table). */
     expect<void>
-    rollback_outputs(account_id user, block_id height, MDB_cursor& outputs_cur) noexcept
+    rollback_outputs(account_id user, block_id height, MDB_cursor& outputs_cur, account_totals* sums = nullptr) noexcept
     {
       MDB_val key = lmdb::to_val(user);
       MDB_val value = lmdb::to_val(height);
@@ -1447,6 +2119,16 @@ namespace db
 
       for (;;)
       {
+        if (sums)
+        {
+          const expect<std::uint64_t> amount =
+            outputs.get_value<MONERO_FIELD(output, spend_meta.amount)>(value);
+          if (!amount)
+            return amount.error();
+          sums->received -= *amount;
+          --sums->outputs;
+        }
+
         MONERO_LMDB_CHECK(mdb_cursor_del(&outputs_cur, 0));
         const int err = mdb_cursor_get(&outputs_cur, &key, &value, MDB_NEXT_DUP);
         if (err == MDB_NOTFOUND)
@@ -1471,16 +2153,22 @@ namespace db
         return {lmdb::error(err)};
 
       std::vector<account_lookup> new_by_heights{};
+      std::vector<output_id> removed_sources{};
+      std::vector<output_id> sources{};
 
       cursor::accounts accounts_cur;
       cursor::outputs outputs_cur;
+      cursor::spendables spendables_cur;
       cursor::spends spends_cur;
       cursor::images images_cur;
+      cursor::totals totals_cur;
 
       MONERO_CHECK(check_cursor(txn, tables.accounts, accounts_cur));
       MONERO_CHECK(check_cursor(txn, tables.outputs, outputs_cur));
+      MONERO_CHECK(check_cursor(txn, tables.spendables, spendables_cur));
       MONERO_CHECK(check_cursor(txn, tables.spends, spends_cur));
       MONERO_CHECK(check_cursor(txn, tables.images, images_cur));
+      MONERO_CHECK(check_cursor(txn, tables.totals, totals_cur));
 
       const std::uint64_t new_height = std::uint64_t(std::max(height, block_id(1))) - 1;
 
@@ -1507,8 +2195,43 @@ namespace db
         MONERO_LMDB_CHECK(mdb_cursor_put(accounts_cur.get(), &key, &value, MDB_CURRENT));
 
         new_by_heights.push_back(account_lookup{user->id, lookup->status});
-        MONERO_CHECK(rollback_outputs(user->id, height, *outputs_cur));
-        MONERO_CHECK(rollback_spends(user->id, height, *spends_cur, *images_cur));
+
+        // subtract only the removed rows, every tip account is here on a reorg
+        expect<account_totals> sums = read_totals(*totals_cur, user->id);
+        if (!sums)
+          return sums.error();
+
+        // spends first, their sources can be in the removed outputs
+        removed_sources.clear();
+        MONERO_CHECK(rollback_spends(user->id, height, *spends_cur, *images_cur, removed_sources));
+        if (!removed_sources.empty())
+        {
+          sources = removed_sources;
+          std::sort(sources.begin(), sources.end());
+          sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+          const expect<std::vector<output::spend_meta_>> metas =
+            find_spend_metas(*spendables_cur, *outputs_cur, user->id, epee::to_span(sources));
+          if (!metas)
+            return metas.error();
+
+          for (const output_id source : removed_sources)
+          {
+            const auto meta = std::lower_bound(metas->begin(), metas->end(), source, [] (const output::spend_meta_& left, const output_id& right)
+            {
+              return left.id < right;
+            });
+            if (meta != metas->end() && meta->id == source)
+              sums->sent -= meta->amount;
+            --sums->spends;
+          }
+        }
+
+        MONERO_CHECK(rollback_outputs(user->id, height, *outputs_cur, std::addressof(*sums)));
+        MONERO_CHECK(rollback_outputs(user->id, height, *spendables_cur));
+
+        sums->locked_height = std::min(sums->locked_height, height);
+        MONERO_CHECK(put_totals(*totals_cur, user->id, *sums));
 
         MONERO_LMDB_CHECK(mdb_cursor_del(accounts_bh_cur.get(), 0));
         int err = mdb_cursor_get(accounts_bh_cur.get(), &key, &value, MDB_NEXT_DUP);
@@ -1595,6 +2318,27 @@ namespace db
         }
       }
 
+      // rollback scan index
+      {
+        cursor::scan_index index_cur;
+        MONERO_CHECK(check_cursor(txn, tables.scan_index, index_cur));
+
+        MDB_val key = lmdb::to_val(height);
+        MDB_val value{};
+        int err = mdb_cursor_get(index_cur.get(), &key, &value, MDB_SET_RANGE);
+        for (;;)
+        {
+          if (err)
+          {
+            if (err == MDB_NOTFOUND)
+              break;
+            return {lmdb::error(err)};
+          }
+          MONERO_LMDB_CHECK(mdb_cursor_del(index_cur.get(), 0));
+          err = mdb_cursor_get(index_cur.get(), &key, &value, MDB_NEXT);
+        }
+      }
+
       if (err != MDB_NOTFOUND)
         return {lmdb::error(err)};
 
@@ -2454,10 +3198,12 @@ namespace db
 
   namespace
   {
+    //! `on_duplicate` is invoked with every spend already stored.
+    template<typename F>
     expect<void>
-    add_spends(MDB_cursor& spends_cur, MDB_cursor& images_cur, account_id user, epee::span<const spend> spends) noexcept
+    add_spends(MDB_cursor& spends_cur, MDB_cursor& images_cur, account_id user, epee::span<const spend> spends, F on_duplicate) noexcept
     {
-      MONERO_CHECK(bulk_insert(spends_cur, user, spends));
+      MONERO_CHECK(bulk_insert(spends_cur, user, spends, MDB_NODUPDATA, std::move(on_duplicate)));
       for (auto const& entry : spends)
       {
         const db::key_image image{entry.image, entry.link};
@@ -2624,18 +3370,8 @@ namespace db
       } // every hook_key
       return success();
     }
-  } // anonymous
-
-  expect<storage::updated> storage::update(block_id height, epee::span<const crypto::hash> chain, epee::span<const lws::account> users, epee::span<const pow_sync> pow)
-  {
-    if (users.empty() && chain.empty())
-      return {updated{}};
-    MONERO_PRECOND(!chain.empty());
-    MONERO_PRECOND(db != nullptr);
-    if (!pow.empty())
-      MONERO_PRECOND(chain.size() == pow.size());
 
-    return db->try_write([this, height, chain, users, pow] (MDB_txn& txn) -> expect<updated>
+    expect<storage::updated> do_update(storage_internal& db, MDB_txn& txn, const block_id height, const epee::span<const crypto::hash> chain, const epee::span<const lws::account> users, const epee::span<const pow_sync> pow)
     {
       epee::span<const crypto::hash> chain_copy{chain};
       epee::span<const pow_sync> pow_copy{pow};
@@ -2644,13 +3380,13 @@ namespace db
       const std::uint64_t first_new = lmdb::to_native(height) + 1;
 
       // collect all .value() errors
-      updated out{};
-      if (get_checkpoints().get_max_height() <= last_update)
+      storage::updated out{};
+      if (storage::get_checkpoints().get_max_height() <= last_update)
       {
         cursor::blocks blocks_cur;
         cursor::pow    pow_cur;
-        MONERO_CHECK(check_cursor(txn, this->db->tables.blocks, blocks_cur));
-        MONERO_CHECK(check_cursor(txn, this->db->tables.pows, pow_cur));
+        MONERO_CHECK(check_cursor(txn, db.tables.blocks, blocks_cur));
+        MONERO_CHECK(check_cursor(txn, db.tables.pows, pow_cur));
 
         MDB_val key = lmdb::to_val(blocks_version);
         MDB_val value;
@@ -2686,7 +3422,7 @@ namespace db
       else // perform chain/pow hardening via checkpoints (if available)
       {
         cursor::blocks blocks_cur;
-        MONERO_CHECK(check_cursor(txn, this->db->tables.blocks, blocks_cur));
+        MONERO_CHECK(check_cursor(txn, db.tables.blocks, blocks_cur));
  
         MDB_val key = lmdb::to_val(blocks_version);
         MDB_val value = lmdb::to_val(last_update);
@@ -2714,22 +3450,29 @@ namespace db
       cursor::accounts_by_address accounts_ba_cur;
       cursor::accounts_by_height  accounts_bh_cur;
       cursor::outputs             outputs_cur;
+      cursor::spendables          spendables_cur;
       cursor::spends              spends_cur;
       cursor::images              images_cur;
       cursor::webhooks            webhooks_cur;
       cursor::events              events_cur;
-
-      MONERO_CHECK(check_cursor(txn, this->db->tables.accounts, accounts_cur));
-      MONERO_CHECK(check_cursor(txn, this->db->tables.accounts_bh, accounts_bh_cur));
-      MONERO_CHECK(check_cursor(txn, this->db->tables.outputs, outputs_cur));
-      MONERO_CHECK(check_cursor(txn, this->db->tables.spends, spends_cur));
-      MONERO_CHECK(check_cursor(txn, this->db->tables.images, images_cur));
-      MONERO_CHECK(check_cursor(txn, this->db->tables.webhooks, webhooks_cur));
-      MONERO_CHECK(check_cursor(txn, this->db->tables.events, events_cur));
+      cursor::totals              totals_cur;
+
+      MONERO_CHECK(check_cursor(txn, db.tables.accounts, accounts_cur));
+      MONERO_CHECK(check_cursor(txn, db.tables.accounts_bh, accounts_bh_cur));
+      MONERO_CHECK(check_cursor(txn, db.tables.outputs, outputs_cur));
+      MONERO_CHECK(check_cursor(txn, db.tables.spendables, spendables_cur));
+      MONERO_CHECK(check_cursor(txn, db.tables.spends, spends_cur));
+      MONERO_CHECK(check_cursor(txn, db.tables.images, images_cur));
+      MONERO_CHECK(check_cursor(txn, db.tables.webhooks, webhooks_cur));
+      MONERO_CHECK(check_cursor(txn, db.tables.events, events_cur));
+      MONERO_CHECK(check_cursor(txn, db.tables.totals, totals_cur));
 
       // for bulk inserts
       boost::container::static_vector<account_lookup, 127> heights{};
       static_assert(sizeof(heights) <= 1024, "stack vector is large");
+      std::vector<spendable_output> new_spendables{};
+      std::vector<bool> old_spends{}; //!< Flags matching `user->spends()`
+      std::vector<output_id> sources{};
 
       for (auto user = users.begin() ;; ++user)
       {
@@ -2755,7 +3498,7 @@ namespace db
           if (err != MDB_NOTFOUND)
             return {lmdb::error(err)};
           if (accounts_ba_cur == nullptr)
-            MONERO_CHECK(check_cursor(txn, this->db->tables.accounts_ba, accounts_ba_cur));
+            MONERO_CHECK(check_cursor(txn, db.tables.accounts_ba, accounts_ba_cur));
 
           MDB_val temp_key = lmdb::to_val(by_address_version);
           MDB_val temp_value = lmdb::to_val(user->db_address());
@@ -2788,8 +3531,76 @@ namespace db
         MONERO_LMDB_CHECK(mdb_cursor_get(accounts_bh_cur.get(), &key, &value, MDB_GET_BOTH));
         MONERO_LMDB_CHECK(mdb_cursor_del(accounts_bh_cur.get(), 0));
 
-        MONERO_CHECK(bulk_insert(*outputs_cur, user->id(), epee::to_span(user->outputs())));
-        MONERO_CHECK(add_spends(*spends_cur, *images_cur, user->id(), epee::to_span(user->spends())));
+        expect<account_totals> sums = read_totals(*totals_cur, user_id);
+        if (!sums)
+          return sums.error();
+        const account_totals old_sums = *sums;
+
+        for (const output& source : user->outputs())
+        {
+          sums->received += source.spend_meta.amount;
+          ++sums->outputs;
+          sums->locked_height = std::min(sums->locked_height, source.link.height);
+        }
+        MONERO_CHECK(
+          bulk_insert(*outputs_cur, user->id(), epee::to_span(user->outputs()), MDB_NODUPDATA, [&sums] (const output& duplicate)
+          {
+            sums->received -= duplicate.spend_meta.amount;
+            --sums->outputs;
+          })
+        );
+
+        new_spendables.clear();
+        for (const output& source : user->outputs())
+          new_spendables.push_back(make_spendable(source));
+        std::sort(new_spendables.begin(), new_spendables.end(), [] (const spendable_output& left, const spendable_output& right)
+        {
+          return left.height == right.height ? left.id < right.id : left.height < right.height;
+        });
+        MONERO_CHECK(bulk_insert(*spendables_cur, user->id(), epee::to_span(new_spendables)));
+        const std::vector<spend>& new_spends = user->spends();
+        std::size_t duplicate_spends = 0;
+        old_spends.assign(new_spends.size(), false);
+        MONERO_CHECK(
+          add_spends(*spends_cur, *images_cur, user->id(), epee::to_span(new_spends), [&] (const spend& duplicate)
+          {
+            old_spends[std::addressof(duplicate) - new_spends.data()] = true;
+            ++duplicate_spends;
+          })
+        );
+
+        if (duplicate_spends != new_spends.size())
+        {
+          sources.clear();
+          for (const spend& s : new_spends)
+            sources.push_back(s.source);
+          std::sort(sources.begin(), sources.end());
+          sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+          const expect<std::vector<output::spend_meta_>> metas =
+            find_spend_metas(*spendables_cur, *outputs_cur, user_id, epee::to_span(sources));
+          if (!metas)
+            return metas.error();
+
+          for (std::size_t i = 0; i < new_spends.size(); ++i)
+          {
+            if (old_spends[i])
+              continue;
+
+            const spend& s = new_spends[i];
+            const auto meta = std::lower_bound(metas->begin(), metas->end(), s.source, [] (const output::spend_meta_& left, const output_id& right)
+            {
+              return left.id < right;
+            });
+            if (meta != metas->end() && meta->id == s.source)
+              sums->sent += meta->amount;
+            ++sums->spends;
+          }
+        }
+
+        MONERO_CHECK(advance_locked(*outputs_cur, user_id, *sums, block_id(last_update)));
+        if (std::memcmp(std::addressof(old_sums), std::addressof(*sums), sizeof(old_sums)) != 0)
+          MONERO_CHECK(put_totals(*totals_cur, user_id, *sums));
 
         MONERO_CHECK(check_hooks(*webhooks_cur, *events_cur, *user));
         MONERO_CHECK(
@@ -2802,6 +3613,124 @@ namespace db
         ++out.accounts_updated;
       } // ... for every account being updated ...
       return {std::move(out)};
+    }
+
+    expect<void> do_add_scan_index(storage_internal& db, MDB_txn& txn, const epee::span<const scan_index_block> blocks)
+    {
+      if (blocks.empty())
+        return success();
+
+      cursor::scan_index index_cur;
+      MONERO_CHECK(check_cursor(txn, db.tables.scan_index, index_cur));
+
+      for (const scan_index_block& block : blocks)
+      {
+        epee::byte_slice bytes{};
+        const std::error_code error = wire::msgpack::to_bytes(bytes, block);
+        if (error)
+          return error;
+
+        MDB_val key = lmdb::to_val(block.height);
+        MDB_val value{bytes.size(), const_cast<void*>(static_cast<const void*>(bytes.data()))};
+        const int err = mdb_cursor_put(index_cur.get(), &key, &value, MDB_NOOVERWRITE);
+        if (err && err != MDB_KEYEXIST)
+          return {lmdb::error(err)};
+      }
+      return success();
+    }
+
+    expect<storage::updated> do_update(storage_internal& db, MDB_txn& txn, const storage::update_request& request)
+    {
+      expect<storage::updated> out =
+        do_update(db, txn, request.height, request.chain, request.users, request.pow);
+      if (out)
+        MONERO_CHECK(do_add_scan_index(db, txn, request.scan_index));
+      return out;
+    }
+  } // anonymous
+
+  expect<storage::updated> storage::update(block_id height, epee::span<const crypto::hash> chain, epee::span<const lws::account> users, epee::span<const pow_sync> pow)
+  {
+    if (users.empty() && chain.empty())
+      return {updated{}};
+    MONERO_PRECOND(!chain.empty());
+    MONERO_PRECOND(db != nullptr);
+    if (!pow.empty())
+      MONERO_PRECOND(chain.size() == pow.size());
+
+    return db->try_write([this, height, chain, users, pow] (MDB_txn& txn) -> expect<updated>
+    {
+      return do_update(*db, txn, height, chain, users, pow);
+    });
+  }
+
+  expect<std::vector<expect<storage::updated>>> storage::update(const epee::span<const update_request> requests)
+  {
+    MONERO_PRECOND(db != nullptr);
+    if (!db->nested_txns)
+    {
+      // `MDB_WRITEMAP` cannot isolate failed requests in a nested txn
+      std::vector<expect<updated>> out{};
+      out.reserve(requests.size());
+      for (const update_request& request : requests)
+      {
+        expect<updated> result{common_error::kInvalidArgument};
+        if (request.users.empty() && request.chain.empty())
+          result = updated{};
+        else
+        {
+          MONERO_PRECOND(!request.chain.empty());
+          if (!request.pow.empty())
+            MONERO_PRECOND(request.chain.size() == request.pow.size());
+          result = db->try_write([this, &request] (MDB_txn& txn) -> expect<updated>
+          {
+            return do_update(*db, txn, request);
+          });
+        }
+
+        if (!result && result.error() != lws::error::blockchain_reorg && result.error() != lws::error::bad_blockchain)
+          return result.error();
+        out.push_back(std::move(result));
+      }
+      return {std::move(out)};
+    }
+
+    for (const update_request& request : requests)
+    {
+      if (!request.users.empty() || !request.chain.empty())
+      {
+        MONERO_PRECOND(!request.chain.empty());
+        if (!request.pow.empty())
+          MONERO_PRECOND(request.chain.size() == request.pow.size());
+      }
+    }
+
+    return db->try_write([this, requests] (MDB_txn& txn) -> expect<std::vector<expect<updated>>>
+    {
+      std::vector<expect<updated>> out{};
+      out.reserve(requests.size());
+      for (const update_request& request : requests)
+      {
+        if (request.users.empty() && request.chain.empty())
+        {
+          out.emplace_back(updated{});
+          continue;
+        }
+
+        // nested txn discards writes from a request that fails
+        MDB_txn* raw_child = nullptr;
+        MONERO_LMDB_CHECK(mdb_txn_begin(mdb_txn_env(&txn), &txn, 0, &raw_child));
+        lmdb::write_txn child{raw_child};
+
+        expect<updated> result = do_update(*db, *child, request);
+        if (result)
+          MONERO_LMDB_CHECK(mdb_txn_commit(child.release()));
+        else if (result.error() != lws::error::blockchain_reorg && result.error() != lws::error::bad_blockchain)
+          return result.error(); // LMDB errors (i.e. map full) fail every request
+
+        out.push_back(std::move(result));
+      }
+      return {std::move(out)};
     });
   }
 
@@ -2811,7 +3740,7 @@ namespace db
     MONERO_PRECOND(db != nullptr);
     std::sort(subaddrs.begin(), subaddrs.end());
 
-    return db->try_write([this, id, &address, &view_key, &subaddrs, max_subaddr] (MDB_txn& txn) -> expect<std::vector<subaddress_dict>>
+    auto upserted = db->try_write([this, id, &address, &view_key, &subaddrs, max_subaddr] (MDB_txn& txn) -> expect<std::vector<subaddress_dict>>
     {
       std::size_t subaddr_count = 0;
       std::vector<subaddress_dict> out{};
@@ -2970,6 +3899,22 @@ namespace db
 
       return {std::move(out)};
     });
+
+    // scanner threads reload subaddress keys for accounts on change
+    if (upserted && !upserted->empty())
+      ++db->subaddress_version;
+    return upserted;
+  }
+
+  expect<void> storage::add_scan_index(const epee::span<const scan_index_block> blocks)
+  {
+    if (blocks.empty())
+      return success();
+
+    return db->try_write([this, blocks] (MDB_txn& txn) -> expect<void>
+    {
+      return do_add_scan_index(*this->db, txn, blocks);
+    });
   }
 
   expect<void> storage::add_webhook(const webhook_type type, const boost::optional<account_address>& address, const webhook_value& event)
@@ -26,6 +26,8 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <iosfwd>
 #include <list>
 #include <memory>
@@ -50,6 +52,7 @@ namespace db
   {
     MONERO_CURSOR(accounts);
     MONERO_CURSOR(outputs);
+    MONERO_CURSOR(spendables);
     MONERO_CURSOR(spends);
     MONERO_CURSOR(images);
     MONERO_CURSOR(requests);
@@ -63,6 +66,8 @@ namespace db
   
     MONERO_CURSOR(webhooks);
     MONERO_CURSOR(events);
+    MONERO_CURSOR(scan_index);
+    MONERO_CURSOR(totals);
   }
 
   struct storage_internal;
@@ -80,6 +85,14 @@ namespace db
     std::vector<std::uint64_t> median_timestamps; //!< for timestamp check
   };
 
+  //! Values from a range of heights, see `storage_reader::get_outputs`.
+  template<typename T>
+  struct height_range
+  {
+    std::vector<T> values;
+    bool more; //!< True iff stopped at `max` with values left in the range
+  };
+
   //! Wrapper for LMDB read access to on-disk storage of light-weight server data.
   class storage_reader
   {
@@ -118,6 +131,15 @@ namespace db
     //! \return Objects for use with cryptonote::next_difficulty and median timestamp check
     expect<pow_window> get_pow_window(block_id last);
 
+    /*!
+      \return Up to `max` consecutive scan index blocks starting at `start`.
+        Stops early at the first missing block, or at the first block that
+        does not match the stored chain. */
+    expect<std::vector<scan_index_block>> get_scan_index(block_id start, std::size_t max);
+
+    //! \return True if scan index has every block from `first` to `last`.
+    expect<bool> has_scan_index(block_id first, block_id last) noexcept;
+
     //! \return All registered `account`s.
     expect<lmdb::key_stream<account_status, account, cursor::close_accounts>>
       get_accounts(cursor::accounts cur = nullptr) noexcept;
@@ -137,14 +159,46 @@ namespace db
     expect<lmdb::value_stream<output, cursor::close_outputs>>
       get_outputs(account_id id, cursor::outputs cur = nullptr) noexcept;
 
+    /*! \return Compact copy of every output received by `id`, read in
+      multi-value pages. Faster than `get_outputs` for rebuilding an
+      `lws::account` before scanning. */
+    expect<std::vector<spendable_output>>
+      get_spendables(account_id id, cursor::spendables cur = nullptr);
+
     //! \return All potential spends by `id`.
     expect<lmdb::value_stream<spend, cursor::close_spends>>
       get_spends(account_id id, cursor::spends cur = nullptr) noexcept;
 
+    //! \return Running totals for `id`, all zeroes if nothing was received.
+    expect<account_totals> get_totals(account_id id, cursor::totals cur = nullptr) noexcept;
+
+    /*! \return Outputs received by `id` at heights [`first`, `last`]. After
+      `max` outputs, stops at the next height so a block is never split, and
+      sets `more` if that height is within the range. */
+    expect<height_range<output>> get_outputs(
+      account_id id, block_id first, block_id last, std::size_t max, cursor::outputs cur = nullptr
+    );
+
+    //! \return Same as `get_outputs` above, except for spends.
+    expect<height_range<spend>> get_spends(
+      account_id id, block_id first, block_id last, std::size_t max, cursor::spends cur = nullptr
+    );
+
+    /*! \return `spend_meta` of each output in `sources` (sorted, unique)
+      received by `id`, sorted by output id. Reads only matching outputs. */
+    expect<std::vector<output::spend_meta_>>
+      get_spend_metas(account_id id, epee::span<const output_id> sources);
+
     //! \return All key images associated with `id`.
     expect<lmdb::value_stream<db::key_image, cursor::close_images>>
       get_images(output_id id, cursor::images cur = nullptr) noexcept;
 
+    /*! \return Key images of every output received by `id`, sorted by
+      output id then image. Same values as `get_images` on each output, but
+      read in one pass over the spends of `id`. */
+    expect<std::vector<std::pair<output_id, crypto::key_image>>>
+      get_images(account_id id, cursor::spends cur = nullptr);
+
     //! \return All `request_info`s.
     expect<lmdb::key_stream<request, request_info, cursor::close_requests>>
       get_requests(cursor::requests cur = nullptr) noexcept;
@@ -156,6 +210,10 @@ namespace db
     //! \return All subaddresses activated for account `id`.
     expect<std::vector<subaddress_dict>> get_subaddresses(account_id id, cursor::subaddress_ranges cur = nullptr) noexcept;
 
+    //! \return All subaddress spend public keys activated for account `id`.
+    expect<lmdb::value_stream<subaddress_map, cursor::close_subaddress_indexes>>
+      get_subaddress_indexes(account_id id, cursor::subaddress_indexes cur = nullptr) noexcept;
+
     //! \return A specific subaddress index
     expect<address_index>
       find_subaddress(account_id id, crypto::public_key const& spend_public, cursor::subaddress_indexes& cur) noexcept;
@@ -175,6 +233,36 @@ namespace db
     lmdb::suspended_txn finish_read() noexcept;
   };
 
+  /*!
+    LMDB environment settings for `storage::open`. The defaults match plain
+    LMDB: every commit is synced to disk. Everything but accounts, webhooks
+    and pending requests can be re-scanned from the chain, so servers
+    can trade crash durability for cheaper commits. */
+  struct storage_options
+  {
+    //! Disk sync after each committed write txn.
+    enum class durability : std::uint8_t
+    {
+      full = 0,     //!< Data and meta pages synced every commit
+      no_meta_sync, //!< `MDB_NOMETASYNC`, last commit(s) can be lost on OS crash
+      no_sync       //!< `MDB_NOSYNC`, commits since last background sync can be lost on OS crash
+    };
+
+    //! Initial LMDB map size in bytes, or 0 for LMDB default/existing size.
+    std::uint64_t map_size = 0;
+
+    //! Background `mdb_env_sync` period, unless `durability::full`.
+    std::chrono::seconds sync_interval = std::chrono::seconds{5};
+
+    durability sync = durability::full;
+
+    //! `MDB_WRITEMAP`, fewer copies on commit. Disables nested txns.
+    bool write_map = false;
+
+    //! `MDB_NORDAHEAD`, for random reads against a DB larger than RAM.
+    bool no_read_ahead = false;
+  };
+
   //! Wrapper for LMDB on-disk storage of light-weight server data.
   class storage
   {
@@ -197,13 +285,14 @@ namespace db
 
       \param path Directory for LMDB storage
       \param create_queue_max Maximum number of create account requests allowed.
+      \param opts LMDB environment flags, map size, and sync policy.
 
       \throw std::system_error on any LMDB error (all treated as fatal).
       \throw std::bad_alloc If `std::shared_ptr` fails to allocate.
 
       \return A ready light-wallet server database.
     */
-    static storage open(const char* path, unsigned create_queue_max);
+    static storage open(const char* path, unsigned create_queue_max, const storage_options& opts = {});
 
     storage(storage&&) = default;
     storage(storage const&) = delete;
@@ -216,6 +305,11 @@ namespace db
     //! \return A copy of the LMDB environment, but not reusable txn/cursors.
     storage clone() const noexcept;
 
+    /*!
+      \return A counter that is incremented after `upsert_subaddresses` adds
+        subaddresses, shared by all clones of `this`. */
+    std::uint64_t subaddress_version() const noexcept;
+
     //! Rollback chain and accounts to `height`.
     expect<void> rollback(block_id height);
 
@@ -286,6 +380,36 @@ namespace db
     expect<updated>
       update(block_id height, epee::span<const crypto::hash> chain, epee::span<const lws::account> accts, epee::span<const pow_sync> pow);
 
+    //! Arguments to a single `update` within a group commit.
+    struct update_request
+    {
+      block_id height;
+      epee::span<const crypto::hash> chain;
+      epee::span<const lws::account> users;
+      epee::span<const pow_sync> pow;
+      epee::span<const scan_index_block> scan_index; //!< Written with the accounts, see `add_scan_index`
+    };
+
+    /*!
+      Same as `update` above, except every request is written in a single
+      LMDB transaction (one disk sync). Each request is applied in a nested
+      transaction, so a request that fails with `blockchain_reorg` or
+      `bad_blockchain` is discarded without affecting the others. With
+      `storage_options::write_map` (no nested txns), each request is
+      written in a separate transaction instead.
+
+      \return Per-request status in the same order as `requests`, or an error
+        if the entire group failed.
+    */
+    expect<std::vector<expect<updated>>>
+      update(epee::span<const update_request> requests);
+
+    /*!
+      Store pruned blocks for re-scanning without a daemon. Blocks already
+      in the index are skipped; stale blocks are removed on chain rollback.
+    */
+    expect<void> add_scan_index(epee::span<const scan_index_block> blocks);
+
     /*!
       Adds subaddresses to an account. Upon success, an account will
       immediately begin tracking them in the scanner.
@@ -178,9 +178,9 @@ namespace lws
 
         response resp{};
 
-        auto outputs = user->second.get_outputs(user->first.id);
-        if (!outputs)
-          return outputs.error();
+        const expect<db::account_totals> totals = user->second.get_totals(user->first.id);
+        if (!totals)
+          return totals.error();
 
         auto spends = user->second.get_spends(user->first.id);
         if (!spends)
@@ -195,31 +195,47 @@ namespace lws
         resp.scanned_height = std::uint64_t(user->first.scan_height);
         resp.scanned_block_height = resp.scanned_height;
         resp.start_height = std::uint64_t(user->first.start_height);
+        resp.total_received = rpc::safe_uint64(totals->received);
+        resp.total_sent = rpc::safe_uint64(totals->sent);
+
+        // outputs below `locked_height` were already unlocked
+        const expect<db::height_range<db::output>> recent = user->second.get_outputs(
+          user->first.id,
+          totals->locked_height,
+          db::block_id(std::numeric_limits<std::uint64_t>::max()),
+          std::numeric_limits<std::size_t>::max()
+        );
+        if (!recent)
+          return recent.error();
 
-        std::vector<db::output::spend_meta_> metas{};
-        metas.reserve(outputs->count());
-
-        for (auto output = outputs->make_iterator(); !output.is_end(); ++output)
+        for (const db::output& output : recent->values)
         {
-          const db::output::spend_meta_ meta =
-            output.get_value<MONERO_FIELD(db::output, spend_meta)>();
-
-          // these outputs will usually be in correct order post ringct
-          if (metas.empty() || metas.back().id < meta.id)
-            metas.push_back(meta);
-          else
-            metas.insert(find_metadata(metas, meta.id), meta);
-
-          resp.total_received = rpc::safe_uint64(std::uint64_t(resp.total_received) + meta.amount);
-          if (is_locked(output.get_value<MONERO_FIELD(db::output, unlock_time)>(), last->id))
-            resp.locked_funds = rpc::safe_uint64(std::uint64_t(resp.locked_funds) + meta.amount);
+          if (is_locked(output.unlock_time, last->id))
+            resp.locked_funds = rpc::safe_uint64(std::uint64_t(resp.locked_funds) + output.spend_meta.amount);
         }
 
-        resp.spent_outputs.reserve(spends->count());
+        std::vector<db::spend> spent{};
+        std::vector<db::output_id> sources{};
+        spent.reserve(spends->count());
+        sources.reserve(spent.capacity());
         for (auto const& spend : spends->make_range())
         {
-          const auto meta = find_metadata(metas, spend.source);
-          if (meta == metas.end() || meta->id != spend.source)
+          spent.push_back(spend);
+          sources.push_back(spend.source);
+        }
+        std::sort(sources.begin(), sources.end());
+        sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+        const expect<std::vector<db::output::spend_meta_>> metas =
+          user->second.get_spend_metas(user->first.id, epee::to_span(sources));
+        if (!metas)
+          return metas.error();
+
+        resp.spent_outputs.reserve(spent.size());
+        for (const db::spend& spend : spent)
+        {
+          const auto meta = find_metadata(*metas, spend.source);
+          if (meta == metas->end() || meta->id != spend.source)
           {
             throw std::logic_error{
               "Serious database error, no receive for spend"
@@ -227,7 +243,6 @@ namespace lws
           }
 
           resp.spent_outputs.push_back({*meta, spend});
-          resp.total_sent = rpc::safe_uint64(std::uint64_t(resp.total_sent) + meta->amount);
         }
 
         resp.rates = client.get_rates();
@@ -240,22 +255,37 @@ namespace lws
 
     struct get_address_txs
     {
-      using request = rpc::account_credentials;
+      using request = rpc::get_address_txs_request;
       using response = rpc::get_address_txs_response;
 
       static expect<response> handle(const request& req, db::storage disk, rpc::client const&, runtime_options const&)
       {
-        auto user = open_account(req, std::move(disk));
+        auto user = open_account(req.creds, std::move(disk));
         if (!user)
           return user.error();
 
-        auto outputs = user->second.get_outputs(user->first.id);
-        if (!outputs)
-          return outputs.error();
+        const db::block_id first = db::block_id(req.from_height.value_or(0));
+        const db::block_id last_height =
+          db::block_id(req.to_height.value_or(std::numeric_limits<std::uint64_t>::max()));
+        const std::size_t limit = req.limit ?
+          std::max(std::size_t(1), std::size_t(*req.limit)) : std::numeric_limits<std::size_t>::max();
 
-        auto spends = user->second.get_spends(user->first.id);
-        if (!spends)
-          return spends.error();
+        // account-wide, not the sum of a page
+        const expect<db::account_totals> totals = user->second.get_totals(user->first.id);
+        if (!totals)
+          return totals.error();
+
+        // both lists end on a height boundary; see `storage_reader::get_outputs`
+        auto output_range = user->second.get_outputs(user->first.id, first, last_height, limit);
+        if (!output_range)
+          return output_range.error();
+
+        auto spend_range = user->second.get_spends(user->first.id, first, last_height, limit);
+        if (!spend_range)
+          return spend_range.error();
+
+        std::vector<db::output>& outputs = output_range->values;
+        std::vector<db::spend>& spends = spend_range->values;
 
         const expect<db::block_info> last = user->second.get_last_block();
         if (!last)
@@ -267,75 +297,129 @@ namespace lws
         resp.start_height = std::uint64_t(user->first.start_height);
         resp.blockchain_height = std::uint64_t(last->id);
         resp.transaction_height = resp.blockchain_height;
+        resp.total_received = rpc::safe_uint64(totals->received);
 
-        // merge input and output info into a single set of txes.
+        // drop entries after `height`, \return True if any were dropped
+        const auto drop_after = [&outputs, &spends] (const db::block_id height)
+        {
+          const auto after = [height] (const auto& entry)
+          {
+            return height < entry.link.height;
+          };
+          const auto output = std::find_if(outputs.begin(), outputs.end(), after);
+          const auto spend = std::find_if(spends.begin(), spends.end(), after);
+          const bool dropped = output != outputs.end() || spend != spends.end();
+          outputs.erase(output, outputs.end());
+          spends.erase(spend, spends.end());
+          return dropped;
+        };
+
+        /* When either list stopped at `limit`, the page ends at the lowest
+          final height of the truncated lists. Later heights of the other
+          list are dropped, and returned on the next page via `next_height`. */
+        boost::optional<db::block_id> cutoff;
+        if (output_range->more)
+          cutoff = outputs.back().link.height;
+        if (spend_range->more)
+          cutoff = std::min(cutoff.value_or(spends.back().link.height), spends.back().link.height);
+
+        if (cutoff)
+        {
+          drop_after(*cutoff);
+          resp.next_height = std::uint64_t(*cutoff) + 1;
+        }
 
-        auto output = outputs->make_iterator();
-        auto spend = spends->make_iterator();
+        /* `limit` applies to both lists combined. The page ends at the
+          height of the `limit`th entry in merged order, so a block is still
+          never split. */
+        if (limit < outputs.size() + spends.size())
+        {
+          std::size_t output = 0;
+          std::size_t spend = 0;
+          db::block_id height = first;
+          for (std::size_t rows = 0; rows < limit; ++rows)
+          {
+            if (spend == spends.size() || (output < outputs.size() && outputs[output].link <= spends[spend].link))
+              height = outputs[output++].link.height;
+            else
+              height = spends[spend++].link.height;
+          }
+          if (drop_after(height))
+            resp.next_height = std::uint64_t(height) + 1;
+        }
 
+        // receives for spends in this page, sorted by id
+        const auto by_id = [] (const auto& left, const auto& right) { return left.id < right.id; };
         std::vector<db::output::spend_meta_> metas{};
+        metas.reserve(outputs.size());
+        for (const db::output& output : outputs)
+          metas.push_back(output.spend_meta);
+        std::sort(metas.begin(), metas.end(), by_id);
+
+        {
+          // receives from before `first` are read separately
+          std::vector<db::output_id> sources{};
+          for (const db::spend& spend : spends)
+          {
+            const auto meta = find_metadata(metas, spend.source);
+            if (meta == metas.end() || meta->id != spend.source)
+              sources.push_back(spend.source);
+          }
+
+          if (!sources.empty())
+          {
+            std::sort(sources.begin(), sources.end());
+            sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
 
-        resp.transactions.reserve(outputs->count());
-        metas.reserve(resp.transactions.capacity());
+            auto older = user->second.get_spend_metas(user->first.id, epee::to_span(sources));
+            if (!older)
+              return older.error();
 
-        db::transaction_link next_output{};
-        db::transaction_link next_spend{};
+            const std::size_t middle = metas.size();
+            metas.insert(metas.end(), older->begin(), older->end());
+            std::inplace_merge(metas.begin(), metas.begin() + middle, metas.end(), by_id);
+          }
+        }
 
-        if (!output.is_end())
-          next_output = output.get_value<MONERO_FIELD(db::output, link)>();
-        if (!spend.is_end())
-          next_spend = spend.get_value<MONERO_FIELD(db::spend, link)>();
+        // merge input and output info into a single set of txes.
 
-        while (!output.is_end() || !spend.is_end())
+        auto output = outputs.begin();
+        auto spend = spends.begin();
+
+        resp.transactions.reserve(outputs.size());
+
+        while (output != outputs.end() || spend != spends.end())
         {
           if (!resp.transactions.empty())
           {
             db::transaction_link const& last = resp.transactions.back().info.link;
 
-            if ((!output.is_end() && next_output < last) || (!spend.is_end() && next_spend < last))
+            if ((output != outputs.end() && output->link < last) || (spend != spends.end() && spend->link < last))
             {
               throw std::logic_error{"DB has unexpected sort order"};
             }
           }
 
-          if (spend.is_end() || (!output.is_end() && next_output <= next_spend))
+          if (spend == spends.end() || (output != outputs.end() && output->link <= spend->link))
           {
-            std::uint64_t amount = 0;
-            if (resp.transactions.empty() || resp.transactions.back().info.link.tx_hash != next_output.tx_hash)
-            {
+            const std::uint64_t amount = output->spend_meta.amount;
+            if (resp.transactions.empty() || resp.transactions.back().info.link.tx_hash != output->link.tx_hash)
               resp.transactions.push_back({*output});
-              amount = resp.transactions.back().info.spend_meta.amount;
-            }
             else
-            {
-              amount = output.get_value<MONERO_FIELD(db::output, spend_meta.amount)>();
               resp.transactions.back().info.spend_meta.amount += amount;
-            }
-
-            const db::output::spend_meta_ meta = output.get_value<MONERO_FIELD(db::output, spend_meta)>();
-            if (metas.empty() || metas.back().id < meta.id)
-              metas.push_back(meta);
-            else
-              metas.insert(find_metadata(metas, meta.id), meta);
-
-            resp.total_received = rpc::safe_uint64(std::uint64_t(resp.total_received) + amount);
-
             ++output;
-            if (!output.is_end())
-              next_output = output.get_value<MONERO_FIELD(db::output, link)>();
           }
-          else if (output.is_end() || (next_spend < next_output))
+          else
           {
-            const db::output_id source_id = spend.get_value<MONERO_FIELD(db::spend, source)>();
-            const auto meta = find_metadata(metas, source_id);
-            if (meta == metas.end() || meta->id != source_id)
+            const auto meta = find_metadata(metas, spend->source);
+            if (meta == metas.end() || meta->id != spend->source)
             {
               throw std::logic_error{
                 "Serious database error, no receive for spend"
               };
             }
 
-            if (resp.transactions.empty() || resp.transactions.back().info.link.tx_hash != next_spend.tx_hash)
+            if (resp.transactions.empty() || resp.transactions.back().info.link.tx_hash != spend->link.tx_hash)
             {
               resp.transactions.push_back({});
               resp.transactions.back().spends.push_back({*meta, *spend});
@@ -350,10 +434,7 @@ namespace lws
               resp.transactions.back().spends.push_back({*meta, *spend});
 
             resp.transactions.back().spent += meta->amount;
-
             ++spend;
-            if (!spend.is_end())
-              next_spend = spend.get_value<MONERO_FIELD(db::spend, link)>();
           }
         }
 
@@ -554,6 +635,11 @@ namespace lws
         if (!outputs)
           return outputs.error();
 
+        // one pass over spends instead of a key image seek per output
+        const auto images = user->second.get_images(user->first.id);
+        if (!images)
+          return images.error();
+
         std::uint64_t received = 0;
         std::vector<std::pair<db::output, std::vector<crypto::key_image>>> unspent;
 
@@ -566,13 +652,13 @@ namespace lws
           received += out.spend_meta.amount;
           unspent.push_back({out, {}});
 
-          auto images = user->second.get_images(out.spend_meta.id);
-          if (!images)
-            return images.error();
-
-          unspent.back().second.reserve(images->count());
-          auto range = images->make_range<MONERO_FIELD(db::key_image, value)>();
-          std::copy(range.begin(), range.end(), std::back_inserter(unspent.back().second));
+          const auto matches = std::equal_range(
+            images->begin(), images->end(), std::make_pair(out.spend_meta.id, crypto::key_image{}),
+            [] (const auto& left, const auto& right) { return left.first < right.first; }
+          );
+          unspent.back().second.reserve(matches.second - matches.first);
+          for (auto image = matches.first; image != matches.second; ++image)
+            unspent.back().second.push_back(image->second);
         }
 
         if (received < std::uint64_t(req.amount))
@@ -229,6 +229,19 @@ namespace lws
     );
   }
 
+  void rpc::read_bytes(wire::json_reader& source, get_address_txs_request& self)
+  {
+    std::string address;
+    wire::object(source,
+      wire::field("address", std::ref(address)),
+      wire::field("view_key", std::ref(unwrap(unwrap(self.creds.key)))),
+      WIRE_OPTIONAL_FIELD(from_height),
+      WIRE_OPTIONAL_FIELD(to_height),
+      WIRE_OPTIONAL_FIELD(limit)
+    );
+    convert_address(address, self.creds.address);
+  }
+
   namespace rpc
   {
     static void write_bytes(wire::json_writer& dest, boost::range::index_value<const get_address_txs_response::transaction&> self)
@@ -276,7 +289,8 @@ namespace lws
       WIRE_FIELD_COPY(start_height),
       WIRE_FIELD_COPY(transaction_height),
       WIRE_FIELD_COPY(blockchain_height),
-      wire::optional_field("transactions", wire::array(boost::adaptors::index(self.transactions)))
+      wire::optional_field("transactions", wire::array(boost::adaptors::index(self.transactions))),
+      WIRE_OPTIONAL_FIELD(next_height)
     );
   }
 
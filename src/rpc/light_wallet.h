@@ -112,6 +112,16 @@ namespace rpc
   void write_bytes(wire::json_writer&, const get_address_info_response&);
 
 
+  struct get_address_txs_request
+  {
+    get_address_txs_request() = delete;
+    account_credentials creds;
+    boost::optional<std::uint64_t> from_height;
+    boost::optional<std::uint64_t> to_height;
+    boost::optional<std::uint32_t> limit;
+  };
+  void read_bytes(wire::json_reader&, get_address_txs_request&);
+
   struct get_address_txs_response
   {
     get_address_txs_response() = delete;
@@ -123,13 +133,14 @@ namespace rpc
       std::uint64_t spent;
     };
 
-    safe_uint64 total_received;
+    safe_uint64 total_received; //!< Account-wide, not only `transactions`
     std::uint64_t scanned_height;
     std::uint64_t scanned_block_height;
     std::uint64_t start_height;
     std::uint64_t transaction_height;
     std::uint64_t blockchain_height;
     std::vector<transaction> transactions;
+    boost::optional<std::uint64_t> next_height; //!< Set when `transactions` was truncated by `limit`
   };
   void write_bytes(wire::json_writer&, const get_address_txs_response&);
 
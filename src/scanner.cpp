@@ -27,6 +27,7 @@
 #include "scanner.h"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/numeric/conversion/cast.hpp>
 #include <boost/range/combine.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -35,18 +36,26 @@
 #include <cassert>
 #include <chrono>
 #include <cstring>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "common/error.h"                             // monero/src
+#include "common/threadpool.h"                        // monero/src
 #include "config.h"
 #include "crypto/crypto.h"                            // monero/src
 #include "crypto/wallet/crypto.h"                     // monero/src
 #include "cryptonote_basic/cryptonote_basic.h"        // monero/src
 #include "cryptonote_basic/cryptonote_format_utils.h" // monero/src
+#include "cryptonote_config.h"                        // monero/src
 #include "db/account.h"
 #include "db/data.h"
 #include "cryptonote_basic/difficulty.h"              // monero/src
@@ -61,6 +70,7 @@
 #include "rpc/lws_pub.h"
 #include "rpc/message_data_structs.h" // monero/src
 #include "rpc/webhook.h"
+#include "serialization/binary_archive.h" // monero/src
 #include "util/blocks.h"
 #include "util/source_location.h"
 #include "util/transactions.h"
@@ -91,533 +101,2498 @@ namespace lws
     constexpr const std::chrono::minutes block_rpc_timeout{2};
     constexpr const std::chrono::seconds send_timeout{30};
     constexpr const std::chrono::seconds sync_rpc_timeout{30};
+    constexpr const std::chrono::seconds block_cache_timeout{30};
+    constexpr const std::size_t scan_index_fetch_max = 1000; //!< Same as daemon default
 
-    struct thread_sync
-    {
-      boost::mutex sync;
-      boost::condition_variable user_poll;
-      std::atomic<bool> update;
-    };
+    //! Block hashes kept by a scan thread for RandomX seeds, before re-reading from DB
+    constexpr const std::size_t pow_hashes_max = 16 * 1024;
+
+    //! Limits on `get_blocks_fast` responses fetched before a scan thread asks
+    constexpr const std::size_t fetch_ahead_max = 4;
+    constexpr const std::size_t fetch_ahead_bytes = 128 * 1024 * 1024;
+
+    //! Limits on view tag columns compared by `scan_outputs`; derived tags are kept for every account
+    constexpr const std::size_t view_tag_column_min = 64;
+    constexpr const std::size_t view_tag_column_max = 4096;
+    constexpr const std::size_t view_tag_bytes_max = 4 * 1024 * 1024;
 
-    struct options
+    //! Accounts within this many blocks of the chain top are scanned by "tip" threads
+    constexpr const std::uint64_t tip_band = 720;
+
+    /*!
+      Shares parsed `get_blocks_fast` responses between scan threads. Scan
+      threads `request()` a block range, and a separate fetch thread retrieves
+      and parses it from the daemon exactly once. Every scan thread at the same
+      height receives the same read-only response from `get()`.
+
+      Responses at the top of the chain (one block) are handed to threads that
+      requested before the response arrived, but are not re-used for later
+      requests since the next request at that height should have new blocks.
+
+      The daemon picks the number of blocks per response, so the size cannot
+      be capped here. Instead, the fetch thread reads ahead of the scan
+      threads by an adaptive number of responses: the depth grows when a scan
+      thread waits on a fetch, and shrinks when a fetched-ahead response
+      expires unused. Responses fetched ahead are also limited by
+      `fetch_ahead_bytes`, using an average of recent response sizes, so
+      spam-era blocks are not stacked in memory. */
+    class block_cache
     {
-      net::ssl_verification_t webhook_verify;
-      bool enable_subaddresses;
-      bool untrusted_daemon;
+    public:
+      using response = std::shared_ptr<const rpc::get_blocks_fast::response>;
+
+    private:
+      struct entry
+      {
+        response blocks; //!< Null while fetch is in progress
+        std::chrono::steady_clock::time_point added;
+        std::size_t bytes; //!< Size of daemon response
+        bool reusable;
+        bool ahead;        //!< Fetched ahead, no scan thread requested yet
+      };
+
+      boost::mutex sync_;
+      boost::condition_variable ready_;
+      boost::condition_variable pending_;
+      std::map<std::uint64_t, entry> entries_;
+      std::deque<std::uint64_t> queue_;
+      const std::size_t max_entries_;
+      std::size_t depth_;          //!< Current number of responses to fetch ahead
+      std::size_t response_bytes_; //!< Moving average of response sizes
+      bool closed_;
+
+      //! Remove expired responses, and the oldest if over `max_entries_`.
+      void expire(const std::chrono::steady_clock::time_point now)
+      {
+        std::size_t count = 0;
+        auto oldest = entries_.end();
+        for (auto elem = entries_.begin(); elem != entries_.end(); )
+        {
+          if (elem->second.blocks && block_cache_timeout <= now - elem->second.added)
+          {
+            if (elem->second.ahead)
+              depth_ = std::max(std::size_t(1), depth_ - 1); // scan threads are slower
+            elem = entries_.erase(elem);
+          }
+          else
+          {
+            if (elem->second.blocks && !elem->second.ahead)
+            {
+              ++count;
+              if (oldest == entries_.end() || elem->second.added < oldest->second.added)
+                oldest = elem;
+            }
+            ++elem;
+          }
+        }
+        if (max_entries_ < count && oldest != entries_.end())
+          entries_.erase(oldest);
+      }
+
+      //! Queue `start_height` for fetching unless pending or re-usable.
+      void queue(const std::uint64_t start_height, const std::chrono::steady_clock::time_point now)
+      {
+        const auto elem = entries_.find(start_height);
+        if (elem != entries_.end())
+        {
+          if (elem->second.ahead)
+          {
+            elem->second.ahead = false;
+            elem->second.added = now;
+            return;
+          }
+          if (!elem->second.blocks || elem->second.reusable)
+            return;
+        }
+
+        entries_[start_height] = entry{nullptr, now, 0, false, false};
+        queue_.push_back(start_height);
+        pending_.notify_one();
+      }
+
+    public:
+      explicit block_cache(const std::size_t max_entries)
+        : sync_(),
+          ready_(),
+          pending_(),
+          entries_(),
+          queue_(),
+          max_entries_(std::max(std::size_t(1), max_entries)),
+          depth_(1),
+          response_bytes_(0),
+          closed_(false)
+      {}
+
+      block_cache(const block_cache&) = delete;
+      block_cache& operator=(const block_cache&) = delete;
+
+      //! Start retrieval of blocks at `start_height`, if not already cached.
+      void request(std::uint64_t start_height)
+      {
+        // RPC server assumes that `start_height == 0` means use
+        // block ids. This technically skips genesis block.
+        start_height = std::max(std::uint64_t(1), start_height);
+
+        const auto now = std::chrono::steady_clock::now();
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        if (closed_)
+          return;
+        expire(now);
+        queue(start_height, now);
+      }
+
+      /*!
+        Wait for blocks at `start_height` from a previous `request()`.
+        \return Null if the fetch failed or the scanner is stopping. */
+      response get(std::uint64_t start_height)
+      {
+        start_height = std::max(std::uint64_t(1), start_height);
+
+        const auto start = std::chrono::steady_clock::now();
+        boost::unique_lock<boost::mutex> lock{sync_};
+        bool waited = false;
+        while (!closed_ && scanner::is_running())
+        {
+          const auto now = std::chrono::steady_clock::now();
+          if (block_rpc_timeout <= now - start)
+          {
+            MWARNING("Block retrieval timeout, resetting scanner");
+            break;
+          }
+
+          const auto elem = entries_.find(start_height);
+          if (elem == entries_.end())
+            queue(start_height, now); // expired before `get()`
+          else if (elem->second.blocks)
+          {
+            // scan threads are faster, fetch further ahead of them
+            if (waited && 1 < elem->second.blocks->blocks.size())
+              depth_ = std::min(fetch_ahead_max, depth_ + 1);
+            return elem->second.blocks;
+          }
+          waited = true;
+          ready_.wait_for(lock, boost::chrono::seconds{1});
+        }
+        return nullptr;
+      }
+
+      //! Wait for next requested start height. \return False if closed.
+      bool next(std::uint64_t& start_height)
+      {
+        boost::unique_lock<boost::mutex> lock{sync_};
+        while (!closed_ && queue_.empty())
+          pending_.wait_for(lock, boost::chrono::seconds{1});
+        if (closed_)
+          return false;
+        start_height = queue_.front();
+        queue_.pop_front();
+        return true;
+      }
+
+      /*!
+        Give `blocks` to threads waiting on `start_height`.
+        \param bytes Size of the daemon response, or 0 if read locally. */
+      void publish(const std::uint64_t start_height, response blocks, const std::size_t bytes)
+      {
+        assert(blocks);
+        {
+          const boost::lock_guard<boost::mutex> lock{sync_};
+          entry& elem = entries_[start_height];
+          elem.reusable = (1 < blocks->blocks.size());
+          elem.blocks = std::move(blocks);
+          elem.added = std::chrono::steady_clock::now();
+          elem.bytes = bytes;
+          if (bytes)
+            response_bytes_ = response_bytes_ ? (response_bytes_ * 3 + bytes) / 4 : bytes;
+        }
+        ready_.notify_all();
+      }
+
+      /*!
+        Queue `start_height` before a scan thread requests it, if within the
+        current depth and `fetch_ahead_bytes`.
+        \return True if queued. */
+      bool fetch_ahead(std::uint64_t start_height)
+      {
+        start_height = std::max(std::uint64_t(1), start_height);
+
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        if (closed_ || entries_.count(start_height))
+          return false;
+
+        std::size_t count = 0;
+        std::size_t bytes = response_bytes_;
+        for (const auto& elem : entries_)
+        {
+          if (elem.second.ahead)
+          {
+            ++count;
+            bytes += elem.second.blocks ? elem.second.bytes : response_bytes_;
+          }
+        }
+        if (depth_ <= count || fetch_ahead_bytes < bytes)
+          return false;
+
+        entries_[start_height] = entry{nullptr, std::chrono::steady_clock::now(), 0, false, true};
+        queue_.push_back(start_height);
+        return true;
+      }
+
+      //! Drop responses with blocks at or after `height`, after a chain reorg.
+      void drop_from(const std::uint64_t height)
+      {
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        for (auto elem = entries_.begin(); elem != entries_.end(); )
+        {
+          const response& blocks = elem->second.blocks;
+          if (blocks && height < elem->first + blocks->blocks.size())
+            elem = entries_.erase(elem);
+          else
+            ++elem;
+        }
+      }
+
+      //! Wakeup all waiting threads, and drop all cached responses.
+      void close()
+      {
+        {
+          const boost::lock_guard<boost::mutex> lock{sync_};
+          closed_ = true;
+          entries_.clear();
+          queue_.clear();
+        }
+        ready_.notify_all();
+        pending_.notify_all();
+      }
     };
 
-    struct thread_data
+    /*!
+      Untrusted-daemon PoW verdicts shared by every scan thread, keyed by
+      block hash. Blocks at or below the last `pows` table entry are already
+      verified and skipped before reaching the ledger. The first thread to
+      `claim()` a block computes its hash; other threads scanning the same
+      block `wait()` for that verdict instead. Entries are dropped once the
+      block is stored in the `pows` table. */
+    class pow_ledger
     {
-      explicit thread_data(rpc::client client, db::storage disk, std::vector<lws::account> users, options opts)
-        : client(std::move(client)), disk(std::move(disk)), users(std::move(users)), opts(opts)
+    public:
+      enum class verdict : std::uint8_t { pending = 0, valid, invalid, released };
+
+    private:
+      boost::mutex sync_;
+      boost::condition_variable done_;
+      std::unordered_map<crypto::hash, std::pair<db::block_id, verdict>> blocks_;
+
+    public:
+      pow_ledger()
+        : sync_(), done_(), blocks_()
       {}
 
-      rpc::client client;
-      db::storage disk;
-      std::vector<lws::account> users;
-      options opts;
+      //! \return True if the caller must verify `id`, false if another thread has or is.
+      bool claim(const crypto::hash& id, const db::block_id height)
+      {
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        return blocks_.emplace(id, std::make_pair(height, verdict::pending)).second;
+      }
+
+      //! Store result for a `claim()`ed block. `verdict::released` drops the claim.
+      void finish(const crypto::hash& id, const verdict result)
+      {
+        {
+          const boost::lock_guard<boost::mutex> lock{sync_};
+          const auto elem = blocks_.find(id);
+          if (elem != blocks_.end())
+          {
+            if (result == verdict::released)
+              blocks_.erase(elem);
+            else
+              elem->second.second = result;
+          }
+        }
+        done_.notify_all();
+      }
+
+      //! \return Verdict of block claimed by another thread, or `released` if dropped.
+      verdict wait(const crypto::hash& id)
+      {
+        boost::unique_lock<boost::mutex> lock{sync_};
+        for (;;)
+        {
+          const auto elem = blocks_.find(id);
+          if (elem == blocks_.end() || !scanner::is_running())
+            return verdict::released;
+          if (elem->second.second != verdict::pending)
+            return elem->second.second;
+          done_.wait_for(lock, boost::chrono::seconds{1});
+        }
+      }
+
+      //! Drop verified blocks at or below `height`, now in the `pows` table.
+      void stored(const db::block_id height)
+      {
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        for (auto elem = blocks_.begin(); elem != blocks_.end(); )
+        {
+          if (elem->second.first <= height && elem->second.second == verdict::valid)
+            elem = blocks_.erase(elem);
+          else
+            ++elem;
+        }
+      }
     };
 
-    // until we have a signal-handler safe notification system
-    void checked_wait(const std::chrono::nanoseconds wait)
+    /*!
+      Serializes `db::storage::update` calls from every `commit_stage`. Scan
+      threads committing within `group_wait` of each other share a single
+      LMDB transaction (and disk sync), instead of queueing on the LMDB write
+      lock. The writer only waits when another scan thread holds a `batch`
+      (is scanning blocks it will commit), so a lone thread at the chain top
+      commits immediately, and a thread does not wait on its own next batch.
+      Each request still receives its own result; see
+      `db::storage::update(span<const update_request>)`. */
+    class commit_group
     {
-      static constexpr const std::chrono::milliseconds interval{500};
+      static constexpr const boost::chrono::milliseconds group_wait{10};
 
-      const auto start = std::chrono::steady_clock::now();
-      while (scanner::is_running())
+      struct request
       {
-        const auto current = std::chrono::steady_clock::now() - start;
-        if (wait <= current)
-          break;
-        const auto sleep_time = std::min(wait - current, std::chrono::nanoseconds{interval});
-        boost::this_thread::sleep_for(boost::chrono::nanoseconds{sleep_time.count()});
+        const db::storage::update_request& args;
+        const void* owner;
+        boost::optional<expect<db::storage::updated>> result;
+        std::exception_ptr failure;
+      };
+
+      boost::mutex sync_;
+      boost::condition_variable ready_;
+      boost::condition_variable done_;
+      std::vector<request*> pending_;
+      std::vector<const void*> scanning_; //!< Owner of every live `batch`
+      const std::size_t max_group_;
+      bool stop_;
+      db::storage disk_;
+      boost::thread thread_;
+
+      //! \return False if `group` failed as a whole, no results were set.
+      bool write_group(const std::vector<request*>& group)
+      {
+        std::vector<db::storage::update_request> args{};
+        args.reserve(group.size());
+        for (const request* req : group)
+          args.push_back(req->args);
+
+        boost::optional<expect<std::vector<expect<db::storage::updated>>>> results;
+        try
+        {
+          results.emplace(disk_.update(epee::to_span(args)));
+        }
+        catch (std::exception const& e)
+        {
+          MWARNING("Group commit of " << group.size() << " request(s) failed, retrying each: " << e.what());
+          return false;
+        }
+        if (!*results)
+        {
+          MWARNING("Group commit of " << group.size() << " request(s) failed, retrying each: " << results->error().message());
+          return false;
+        }
+
+        {
+          const boost::lock_guard<boost::mutex> lock{sync_};
+          for (std::size_t i = 0; i < group.size(); ++i)
+            group[i]->result.emplace(std::move((**results)[i]));
+        }
+        done_.notify_all();
+        return true;
       }
-    }
 
-    bool is_new_block(std::string&& chain_msg, db::storage& disk, const account& user)
-    {
-      const auto chain = rpc::minimal_chain_pub::from_json(std::move(chain_msg));
-      if (!chain)
+      void write_one(request& req)
       {
-        MERROR("Unable to parse blockchain notification: " << chain.error());
+        boost::optional<expect<db::storage::updated>> result;
+        std::exception_ptr failure{};
+        try
+        {
+          auto results = disk_.update({std::addressof(req.args), 1});
+          if (results)
+            result.emplace(std::move(results->at(0)));
+          else
+            result.emplace(results.error());
+        }
+        catch (...)
+        {
+          failure = std::current_exception();
+        }
+
+        {
+          const boost::lock_guard<boost::mutex> lock{sync_};
+          req.result = std::move(result);
+          req.failure = failure;
+        }
+        done_.notify_all();
+      }
+
+      /* A failure other than a reorg aborts the shared transaction, so the
+         requests are retried alone. Only the thread that owns the failing
+         request receives the error. */
+      void write(const std::vector<request*>& group)
+      {
+        if (1 < group.size() && write_group(group))
+          return;
+        for (request* req : group)
+          write_one(*req);
+      }
+
+      //! \pre `sync_` is locked. \return True if a thread without a pending request is scanning.
+      bool expecting_request() const
+      {
+        for (const void* owner : scanning_)
+        {
+          const auto same = [owner] (const request* req) { return req->owner == owner; };
+          if (std::none_of(pending_.begin(), pending_.end(), same))
+            return true;
+        }
         return false;
       }
 
-      if (user.scan_height() < db::block_id(chain->top_block_height))
-        return true;
+      void run() noexcept
+      {
+        std::vector<request*> group{};
+        for (;;)
+        {
+          {
+            boost::unique_lock<boost::mutex> lock{sync_};
+            while (pending_.empty() && !stop_)
+              ready_.wait(lock);
+            if (pending_.empty())
+              return;
 
-      auto reader = disk.start_read();
-      if (!reader)
+            // give other scan threads a chance to join the transaction
+            const auto deadline = boost::chrono::steady_clock::now() + group_wait;
+            while (!stop_ && pending_.size() < max_group_ && expecting_request())
+            {
+              if (ready_.wait_until(lock, deadline) == boost::cv_status::timeout)
+                break;
+            }
+            group.swap(pending_);
+          }
+
+          write(group);
+          group.clear();
+        }
+      }
+
+      void begin_batch(const void* owner)
       {
-        MWARNING("Failed to start DB read: " << reader.error());
-        return true;
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        scanning_.push_back(owner);
       }
 
-      // check possible chain rollback daemon side
-      const expect<crypto::hash> id = reader->get_block_hash(db::block_id(chain->top_block_height));
-      if (!id || *id != chain->top_block_id)
-        return true;
+      void end_batch(const void* owner) noexcept
+      {
+        {
+          const boost::lock_guard<boost::mutex> lock{sync_};
+          const auto elem = std::find(scanning_.begin(), scanning_.end(), owner);
+          if (elem != scanning_.end())
+            scanning_.erase(elem);
+        }
+        ready_.notify_all();
+      }
 
-      // check possible chain rollback from other thread
-      const expect<db::account> user_db = reader->get_account(db::account_status::active, user.id());
-      return !user_db || user_db->scan_height != user.scan_height();
-    }
+    public:
+      /*!
+        Held by a scan thread from the start of a batch until its commit
+        request is queued, so the writer knows another request is coming. */
+      class batch
+      {
+        commit_group* group_;
+        const void* owner_;
 
-    bool send(rpc::client& client, epee::byte_slice message)
+      public:
+        batch() noexcept
+          : group_(nullptr), owner_(nullptr)
+        {}
+
+        //! `owner` is the value later given to `commit_group::update`.
+        explicit batch(commit_group& group, const void* owner)
+          : group_(std::addressof(group)), owner_(owner)
+        {
+          group.begin_batch(owner);
+        }
+
+        batch(batch&& rhs) noexcept
+          : group_(rhs.group_), owner_(rhs.owner_)
+        {
+          rhs.group_ = nullptr;
+        }
+
+        batch(const batch&) = delete;
+
+        ~batch() noexcept { reset(); }
+
+        batch& operator=(batch&& rhs) noexcept
+        {
+          if (this != std::addressof(rhs))
+          {
+            reset();
+            group_ = rhs.group_;
+            owner_ = rhs.owner_;
+            rhs.group_ = nullptr;
+          }
+          return *this;
+        }
+
+        batch& operator=(const batch&) = delete;
+
+        void reset() noexcept
+        {
+          if (group_)
+            group_->end_batch(owner_);
+          group_ = nullptr;
+        }
+      };
+
+      explicit commit_group(db::storage disk, const std::size_t max_group)
+        : sync_(),
+          ready_(),
+          done_(),
+          pending_(),
+          scanning_(),
+          max_group_(std::max(std::size_t(1), max_group)),
+          stop_(false),
+          disk_(std::move(disk)),
+          thread_()
+      {
+        boost::thread::attributes attrs;
+        attrs.set_stack_size(THREAD_STACK_SIZE);
+        thread_ = boost::thread{attrs, [this] () { run(); }};
+      }
+
+      commit_group(const commit_group&) = delete;
+      commit_group& operator=(const commit_group&) = delete;
+
+      //! Writes all pending requests, then joins the thread.
+      ~commit_group() noexcept
+      {
+        {
+          const boost::lock_guard<boost::mutex> lock{sync_};
+          stop_ = true;
+        }
+        ready_.notify_all();
+        thread_.join();
+      }
+
+      /*! Blocks until `args` is written. `scan` is released once queued.
+        \throw Any exception from `db::storage::update`. */
+      expect<db::storage::updated> update(const db::storage::update_request& args, const void* owner, batch scan)
+      {
+        request req{args, owner, boost::none, nullptr};
+        {
+          const boost::lock_guard<boost::mutex> lock{sync_};
+          pending_.push_back(std::addressof(req));
+        }
+        scan.reset();
+        ready_.notify_all();
+
+        boost::unique_lock<boost::mutex> lock{sync_};
+        while (!req.result && !req.failure)
+          done_.wait(lock);
+        if (req.failure)
+          std::rethrow_exception(req.failure);
+        return std::move(*req.result);
+      }
+    };
+
+    /*!
+      Chain sync after a scan thread finds a reorg. Threads that hit the same
+      reorg wait for the first one, and skip the sync if one completed after
+      their last batch started. Uses its own client, so the pub/sub and scan
+      sockets of a scan thread are never used for the sync. */
+    class reorg_sync
     {
-      const expect<void> sent = client.send(std::move(message), send_timeout);
-      if (!sent)
+      boost::mutex sync_;
+      rpc::client client_;
+      std::atomic<std::uint64_t> synced_; //!< Number of completed syncs
+
+    public:
+      explicit reorg_sync(rpc::client client)
+        : sync_(), client_(std::move(client)), synced_(0)
+      {}
+
+      reorg_sync(const reorg_sync&) = delete;
+      reorg_sync& operator=(const reorg_sync&) = delete;
+
+      std::uint64_t synced() const noexcept { return synced_; }
+
+      /*!
+        Sync the chain in `disk` with the daemon, unless a sync completed
+        since `seen` was read from `synced()`. After a failure the client is
+        lost, callers must reset the scanner. */
+      expect<void> sync(db::storage disk, const bool untrusted_daemon, const std::uint64_t seen)
       {
-        if (sent.matches(std::errc::interrupted))
+        const boost::lock_guard<boost::mutex> lock{sync_};
+        if (seen != synced_)
+          return success();
+        if (!client_)
+          return {lws::error::daemon_timeout};
+
+        expect<rpc::client> synced = scanner::sync(std::move(disk), std::move(client_), untrusted_daemon);
+        if (!synced)
+          return synced.error();
+        client_ = std::move(*synced);
+        ++synced_;
+        return success();
+      }
+    };
+
+    struct thread_sync
+    {
+      explicit thread_sync(db::storage disk, const std::size_t thread_count, rpc::client sync_client)
+        : sync(), user_poll(), update(false), blocks(thread_count * 2), pow(), writer(std::move(disk), thread_count), reorg(std::move(sync_client)), handoff_sync(), handoff(), catch_up(), removed(), removed_count(0), tip_threads(0), catch_up_threads(0), scan_threads(0)
+      {}
+
+      boost::mutex sync;
+      boost::condition_variable user_poll;
+      std::atomic<bool> update;
+      block_cache blocks;
+
+      pow_ledger pow;
+      commit_group writer; //!< `db::storage::update` for every `commit_stage`
+      reorg_sync reorg;
+
+      boost::mutex handoff_sync;
+      std::vector<lws::account> handoff;   //!< New accounts, and from catch-up threads that reached the chain top
+      std::vector<lws::account> catch_up;  //!< New accounts behind the tip band, for a running catch-up thread
+      std::vector<db::account_id> removed; //!< Sorted, deactivated since threads started
+      std::atomic<std::size_t> removed_count;
+      std::size_t tip_threads;             //!< Threads that take accounts from `handoff`
+      std::size_t catch_up_threads;        //!< Threads that take accounts from `catch_up`
+      std::atomic<std::size_t> scan_threads; //!< Running `scan_loop`s, including detached ones until they return
+
+      /*!
+        Give `users` to a tip thread, or make the calling thread a tip thread
+        when none exist. \return True if `users` were handed off. */
+      bool hand_off(std::vector<lws::account>& users)
+      {
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        if (!tip_threads)
+        {
+          ++tip_threads;
           return false;
-        MONERO_THROW(sent.error(), "Failed to send ZMQ RPC message");
+        }
+        handoff.insert(handoff.end(), std::make_move_iterator(users.begin()), std::make_move_iterator(users.end()));
+        users.clear();
+        return true;
+      }
+
+      //! Append accounts handed off by catch-up threads to `out`.
+      void take_handoff(std::vector<lws::account>& out)
+      {
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        out.insert(out.end(), std::make_move_iterator(handoff.begin()), std::make_move_iterator(handoff.end()));
+        handoff.clear();
+      }
+
+      /*!
+        Give new `users` to the tip threads, if any are running. The check
+        and hand off are one step, so the last tip thread cannot stop in
+        between. \return True if `users` were handed off. */
+      bool give_tip_threads(std::vector<lws::account>& users)
+      {
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        if (!tip_threads)
+          return false;
+        handoff.insert(handoff.end(), std::make_move_iterator(users.begin()), std::make_move_iterator(users.end()));
+        users.clear();
+        return true;
+      }
+
+      /*!
+        Give new `users` behind the tip band to the running catch-up
+        threads (or tip threads, if none) once `max_threads` tip and catch-up
+        threads are running. \return True if `users` were handed off. */
+      bool give_catch_up_threads(std::vector<lws::account>& users, const std::size_t max_threads)
+      {
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        if (tip_threads + catch_up_threads < max_threads)
+          return false;
+        std::vector<lws::account>& queue = catch_up_threads ? catch_up : handoff;
+        queue.insert(queue.end(), std::make_move_iterator(users.begin()), std::make_move_iterator(users.end()));
+        users.clear();
+        return true;
+      }
+
+      //! Append accounts waiting for a `tip` (or catch-up) thread to `out`.
+      void take_new(std::vector<lws::account>& out, const bool tip)
+      {
+        if (tip)
+        {
+          take_handoff(out);
+          return;
+        }
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        out.insert(out.end(), std::make_move_iterator(catch_up.begin()), std::make_move_iterator(catch_up.end()));
+        catch_up.clear();
+      }
+
+      /*!
+        The calling thread stops being a `tip` (or catch-up) thread, because
+        it has no accounts left or a catch-up thread reached the chain top.
+        \return False if the thread must keep running, because it is the
+          last of its kind and accounts are waiting for it. */
+      bool leave(const bool tip)
+      {
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        std::size_t& count = tip ? tip_threads : catch_up_threads;
+        const std::vector<lws::account>& waiting = tip ? handoff : catch_up;
+        assert(count);
+        if (count == 1 && !waiting.empty())
+          return false;
+        --count;
+        return true;
+      }
+
+      //! Scan threads drop `ids` on their next batch, without a restart.
+      void remove_accounts(epee::span<const db::account_id> ids)
+      {
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        for (const db::account_id id : ids)
+        {
+          const auto loc = std::lower_bound(removed.begin(), removed.end(), id);
+          if (loc == removed.end() || *loc != id)
+            removed.insert(loc, id);
+        }
+        removed_count = removed.size();
+      }
+
+      //! \return True if `id` was removed since threads started.
+      bool is_removed(const db::account_id id)
+      {
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        return std::binary_search(removed.begin(), removed.end(), id);
+      }
+
+      /*!
+        Remove accounts from `users` that were passed to `remove_accounts`
+        since `seen` (updated) was last checked. Order of `users` is kept.
+        \return True if `users` changed. */
+      bool drop_removed(std::vector<lws::account>& users, std::size_t& seen)
+      {
+        if (seen == removed_count)
+          return false;
+
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        seen = removed.size();
+        return erase_removed(users);
+      }
+
+      //! Remove every account from `users` passed to `remove_accounts`.
+      void drop_removed(std::vector<lws::account>& users)
+      {
+        if (!removed_count)
+          return;
+        const boost::lock_guard<boost::mutex> lock{handoff_sync};
+        erase_removed(users);
+      }
+
+    private:
+      //! \pre `handoff_sync` is locked
+      bool erase_removed(std::vector<lws::account>& users)
+      {
+        const auto last = std::remove_if(users.begin(), users.end(), [this] (const lws::account& user)
+        {
+          return std::binary_search(removed.begin(), removed.end(), user.id());
+        });
+        const bool changed = last != users.end();
+        users.erase(last, users.end());
+        return changed;
+      }
+    };
+
+    struct fetch_data
+    {
+      rpc::client client;
+      db::storage disk;        //!< Only used with `scanner_options::scan_index`
+    };
+
+    struct thread_data
+    {
+      explicit thread_data(rpc::client client, rpc::client commit_client, db::storage disk, std::vector<lws::account> users, scanner_options opts, bool tip)
+        : client(std::move(client)), commit_client(std::move(commit_client)), disk(std::move(disk)), users(std::move(users)), opts(opts), tip(tip)
+      {}
+
+      rpc::client client;
+      rpc::client commit_client; //!< Webhooks and publishing from `commit_stage`
+      db::storage disk;
+      std::vector<lws::account> users;
+      scanner_options opts;
+      bool tip; //!< Pulls new accounts; otherwise hands off accounts at chain top
+    };
+
+    // until we have a signal-handler safe notification system
+    void checked_wait(const std::chrono::nanoseconds wait)
+    {
+      static constexpr const std::chrono::milliseconds interval{500};
+
+      const auto start = std::chrono::steady_clock::now();
+      while (scanner::is_running())
+      {
+        const auto current = std::chrono::steady_clock::now() - start;
+        if (wait <= current)
+          break;
+        const auto sleep_time = std::min(wait - current, std::chrono::nanoseconds{interval});
+        boost::this_thread::sleep_for(boost::chrono::nanoseconds{sleep_time.count()});
+      }
+    }
+
+    bool is_new_block(std::string&& chain_msg, db::storage& disk, const account& user)
+    {
+      const auto chain = rpc::minimal_chain_pub::from_json(std::move(chain_msg));
+      if (!chain)
+      {
+        MERROR("Unable to parse blockchain notification: " << chain.error());
+        return false;
+      }
+
+      if (user.scan_height() < db::block_id(chain->top_block_height))
+        return true;
+
+      auto reader = disk.start_read();
+      if (!reader)
+      {
+        MWARNING("Failed to start DB read: " << reader.error());
+        return true;
+      }
+
+      // check possible chain rollback daemon side
+      const expect<crypto::hash> id = reader->get_block_hash(db::block_id(chain->top_block_height));
+      if (!id || *id != chain->top_block_id)
+        return true;
+
+      // check possible chain rollback from other thread
+      const expect<db::account> user_db = reader->get_account(db::account_status::active, user.id());
+      return !user_db || user_db->scan_height != user.scan_height();
+    }
+
+    bool send(rpc::client& client, epee::byte_slice message)
+    {
+      const expect<void> sent = client.send(std::move(message), send_timeout);
+      if (!sent)
+      {
+        if (sent.matches(std::errc::interrupted))
+          return false;
+        MONERO_THROW(sent.error(), "Failed to send ZMQ RPC message");
+      }
+      return true;
+    }
+
+    /*!
+      \return Blocks from the scan index starting at `start_height`, or null
+        if less than two are available. A single block signals the top of the
+        chain to scan threads, so that case is left to the daemon. With
+        `untrusted_daemon`, blocks above the last PoW checked block are left
+        to the daemon too, since index blocks cannot be hashed. The last PoW
+        block is read on every call, because a reorg can roll it back. */
+    block_cache::response read_scan_index(db::storage& disk, const std::uint64_t start_height, const bool untrusted_daemon)
+    {
+      auto reader = disk.start_read();
+      if (!reader)
+      {
+        MWARNING("Failed to start DB read: " << reader.error());
+        return nullptr;
+      }
+
+      std::size_t max_blocks = scan_index_fetch_max;
+      if (untrusted_daemon)
+      {
+        const expect<db::block_pow> last_pow = reader->get_last_pow_block();
+        if (!last_pow)
+        {
+          MWARNING("Failed to read last PoW block: " << last_pow.error().message());
+          return nullptr;
+        }
+        if (std::uint64_t(last_pow->id) <= start_height)
+          return nullptr;
+        max_blocks = std::min(max_blocks, std::size_t(std::uint64_t(last_pow->id) - start_height + 1));
+      }
+
+      expect<std::vector<db::scan_index_block>> blocks =
+        reader->get_scan_index(db::block_id(start_height), max_blocks);
+      if (!blocks)
+      {
+        MWARNING("Failed to read scan index: " << blocks.error().message());
+        return nullptr;
+      }
+      if (blocks->size() < 2)
+        return nullptr;
+
+      auto out = std::make_shared<rpc::get_blocks_fast::response>(
+        rpc::get_blocks_fast::response{{}, {}, start_height, start_height + blocks->size() - 1}
+      );
+
+      // reserve up front, block copies drop the cached tx hashes
+      out->blocks.reserve(blocks->size());
+      out->output_indices.reserve(blocks->size());
+      for (db::scan_index_block& block : *blocks)
+      {
+        if (block.txes.empty())
+        {
+          MERROR("Scan index block " << std::uint64_t(block.height) << " is missing miner tx");
+          return nullptr;
+        }
+
+        out->blocks.emplace_back();
+        out->output_indices.emplace_back();
+        cryptonote::rpc::block_with_transactions& dest = out->blocks.back();
+        dest.block.major_version = block.major_version;
+        dest.block.minor_version = block.minor_version;
+        dest.block.timestamp = block.timestamp;
+        dest.block.prev_id = block.prev_id;
+        dest.block.nonce = 0;
+        dest.block.tx_hashes.reserve(block.txes.size() - 1);
+        dest.transactions.reserve(block.txes.size() - 1);
+        out->output_indices.back().reserve(block.txes.size());
+
+        bool miner_tx = true;
+        for (db::scan_index_tx& tx : block.txes)
+        {
+          cryptonote::transaction* parsed = std::addressof(dest.block.miner_tx);
+          if (!miner_tx)
+          {
+            dest.block.tx_hashes.push_back(tx.hash);
+            dest.transactions.emplace_back();
+            parsed = std::addressof(dest.transactions.back());
+          }
+          miner_tx = false;
+
+          if (!cryptonote::parse_and_validate_tx_base_from_blob(tx.base, *parsed))
+          {
+            MERROR("Failed to parse transaction " << tx.hash << " from scan index");
+            return nullptr;
+          }
+
+          // the full tx hash cannot be computed from the pruned tx
+          parsed->hash = tx.hash;
+          parsed->set_hash_valid(true);
+          out->output_indices.back().push_back(std::move(tx.output_indices));
+        }
+
+        dest.block.hash = block.hash;
+        dest.block.set_hash_valid(true);
+      }
+
+      MDEBUG("Read " << out->blocks.size() << " block(s) from scan index at height " << start_height);
+      return out;
+    }
+
+    //! \return `block` with pruned transactions for the scan index.
+    db::scan_index_block make_scan_index(const db::block_id height, const cryptonote::rpc::block_with_transactions& block, const std::vector<std::vector<std::uint64_t>>& indices)
+    {
+      if (block.transactions.size() + 1 != indices.size())
+        throw std::runtime_error{"Bad daemon response - need same number of txes and indices"};
+
+      db::scan_index_block out{
+        height,
+        cryptonote::get_block_hash(block.block),
+        block.block.prev_id,
+        block.block.timestamp,
+        block.block.major_version,
+        block.block.minor_version,
+        {}
+      };
+      out.txes.reserve(indices.size());
+
+      const auto add_tx = [&out] (const crypto::hash& hash, const cryptonote::transaction& tx, const std::vector<std::uint64_t>& indices)
+      {
+        // `tx` is shared with other scan threads, serialize a copy of the pruned fields
+        cryptonote::transaction base{};
+        static_cast<cryptonote::transaction_prefix&>(base) = tx;
+        static_cast<rct::rctSigBase&>(base.rct_signatures) = tx.rct_signatures;
+
+        std::stringstream stream{};
+        binary_archive<true> archive{stream};
+        if (!base.serialize_base(archive))
+          throw std::runtime_error{"Failed to serialize transaction for scan index"};
+        out.txes.push_back(db::scan_index_tx{hash, stream.str(), indices});
+      };
+
+      add_tx(cryptonote::get_transaction_hash(block.block.miner_tx), block.block.miner_tx, indices.front());
+      for (std::size_t i = 0; i < block.transactions.size(); ++i)
+        add_tx(block.block.tx_hashes.at(i), block.transactions[i], indices[i + 1]);
+      return out;
+    }
+
+    //! \return True if any block from `first` to `last` is missing from the scan index.
+    bool needs_scan_index(db::storage& disk, const db::block_id first, const db::block_id last)
+    {
+      auto reader = disk.start_read();
+      if (!reader)
+        return true;
+      const expect<bool> indexed = reader->has_scan_index(first, last);
+      return !indexed || !*indexed;
+    }
+
+    /*!
+      Retrieves and parses blocks requested via `cache`, until the scanner is
+      reset. Any failure resets all scan threads, like a failed fetch did when
+      each thread retrieved its own blocks. With `scanner_options::scan_index`,
+      blocks are read from the local scan index instead of the daemon when
+      available. */
+    void fetch_loop(block_cache& cache, std::shared_ptr<fetch_data> data, const scanner_options opts) noexcept
+    {
+      try
+      {
+        // boost::thread doesn't support move-only types + attributes
+        rpc::client client{std::move(data->client)};
+        db::storage disk{std::move(data->disk)};
+        data.reset();
+
+        const bool untrusted_daemon = opts.untrusted_daemon;
+        cryptonote::rpc::GetBlocksFast::Request req{};
+        req.prune = !untrusted_daemon;
+
+        while (scanner::is_running() && cache.next(req.start_height))
+        {
+          if (opts.scan_index)
+          {
+            block_cache::response local = read_scan_index(disk, req.start_height, untrusted_daemon);
+            if (local)
+            {
+              const std::uint64_t next_height = req.start_height + local->blocks.size() - 1;
+              cache.publish(req.start_height, std::move(local), 0);
+              cache.fetch_ahead(next_height);
+              continue;
+            }
+          }
+
+          if (!send(client, rpc::client::make_message("get_blocks_fast", req)))
+            return;
+
+          const auto fetch_start = std::chrono::steady_clock::now();
+          auto resp = client.get_message(block_rpc_timeout);
+          if (!resp)
+          {
+            const bool timeout = resp.matches(std::errc::timed_out);
+            if (timeout)
+              MWARNING("Block retrieval timeout, resetting scanner");
+            if (timeout || resp.matches(std::errc::interrupted))
+            {
+              cache.close();
+              return;
+            }
+            MONERO_THROW(resp.error(), "Failed to retrieve blocks from daemon");
+          }
+
+          const std::size_t bytes = resp->size();
+          const auto parse_start = std::chrono::steady_clock::now();
+          auto fetched = rpc::parse_json_response<rpc::get_blocks_fast>(std::move(*resp));
+          if (!fetched)
+          {
+            MERROR("Failed to retrieve next blocks: " << fetched.error().message() << ". Resetting state and trying again");
+            cache.close();
+            return;
+          }
+
+          if (fetched->blocks.empty())
+            throw std::runtime_error{"Daemon unexpectedly returned zero blocks"};
+
+          if (fetched->start_height != req.start_height)
+          {
+            MWARNING("Daemon sent wrong blocks, resetting state");
+            cache.close();
+            return;
+          }
+
+          // cache hashes before sharing, scan threads must only read
+          for (const auto& block : fetched->blocks)
+          {
+            cryptonote::get_block_hash(block.block);
+            if (untrusted_daemon)
+            {
+              for (const auto& tx : block.transactions)
+                cryptonote::get_transaction_hash(tx);
+            }
+          }
+
+          const std::size_t count = fetched->blocks.size();
+          const auto now = std::chrono::steady_clock::now();
+          MDEBUG("Fetched " << count << " block(s) at " << req.start_height << " (" << bytes << " bytes) in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(parse_start - fetch_start).count() << " ms, parsed in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(now - parse_start).count() << " ms");
+
+          cache.publish(
+            req.start_height,
+            std::make_shared<rpc::get_blocks_fast::response>(std::move(*fetched)),
+            bytes
+          );
+          if (1 < count)
+            cache.fetch_ahead(req.start_height + count - 1);
+        }
+      }
+      catch (std::exception const& e)
+      {
+        scanner::stop();
+        cache.close();
+        MERROR(e.what());
+      }
+      catch (...)
+      {
+        scanner::stop();
+        cache.close();
+        MERROR("Unknown exception");
+      }
+    }
+
+    void send_payment_hook(rpc::client& client, const epee::span<const db::webhook_tx_confirmation> events, net::ssl_verification_t verify_mode)
+    {
+      rpc::send_webhook(client, events, "json-full-payment_hook:", "msgpack-full-payment_hook:", std::chrono::seconds{5}, verify_mode);
+    }
+
+    std::size_t get_target_time(db::block_id height)
+    {
+      const hardfork_t* fork = nullptr;
+      switch (config::network)
+      {
+      case cryptonote::network_type::MAINNET:
+        if (num_mainnet_hard_forks < 2)
+          MONERO_THROW(error::bad_blockchain, "expected more mainnet forks");
+        fork = mainnet_hard_forks;
+        break;     
+      case cryptonote::network_type::TESTNET:
+         if (num_testnet_hard_forks < 2)
+          MONERO_THROW(error::bad_blockchain, "expected more testnet forks");
+        fork = testnet_hard_forks;
+        break; 
+      case cryptonote::network_type::STAGENET:
+         if (num_stagenet_hard_forks < 2)
+          MONERO_THROW(error::bad_blockchain, "expected more stagenet forks");
+        fork = stagenet_hard_forks;
+        break;
+      default:
+        MONERO_THROW(error::bad_blockchain, "chain type not support with full sync"); 
+      } 
+      // this is hardfork version 2
+      return height < db::block_id(fork[1].height) ?
+        DIFFICULTY_TARGET_V1 : DIFFICULTY_TARGET_V2;
+    }
+
+    void send_spend_hook(rpc::client& client, const epee::span<const db::webhook_tx_spend> events, net::ssl_verification_t verify_mode)
+    {
+      rpc::send_webhook(client, events, "json-full-spend_hook:", "msgpack-full-spend_hook:", std::chrono::seconds{5}, verify_mode);
+    }
+
+    struct by_height
+    {
+      bool operator()(account const& left, account const& right) const noexcept
+      {
+        return left.scan_height() < right.scan_height();
+      }
+    };
+
+    struct add_spend
+    {
+      void operator()(lws::account& user, const db::spend& spend) const
+      { user.add_spend(spend); }
+    };
+    struct null_spend
+    {
+      void operator()(lws::account&, const db::spend&) const noexcept
+      {}
+    };
+    /*!
+      Txpool transactions seen by one scan thread, keyed by tx prefix hash.
+      Each transaction is scanned once per account set. Txpool pubs do not
+      include the tx hash, so it is filled from `get_transaction_pool` only
+      when a webhook needs a transaction that is not in an earlier response.
+      Entries are dropped when mined, or after the daemon txpool lifetime. */
+    class txpool_cache
+    {
+      struct entry
+      {
+        std::chrono::steady_clock::time_point added;
+        boost::optional<crypto::hash> tx_hash;
+        std::uint64_t scanned; //!< `version_` at last scan, 0 if never
+        bool fetched;          //!< `get_transaction_pool` already tried
+      };
+
+      std::unordered_map<crypto::hash, entry> txes_;
+      std::uint64_t version_;
+
+      entry& get(const crypto::hash& prefix_hash)
+      {
+        return txes_.emplace(
+          prefix_hash, entry{std::chrono::steady_clock::now(), boost::none, 0, false}
+        ).first->second;
+      }
+
+    public:
+      txpool_cache()
+        : txes_(), version_(1)
+      {}
+
+      bool empty() const noexcept { return txes_.empty(); }
+
+      //! Accounts were added or removed, previous scans are incomplete.
+      void accounts_changed() noexcept { ++version_; }
+
+      //! \return True if `prefix_hash` was not scanned with current accounts.
+      bool mark_scanned(const crypto::hash& prefix_hash)
+      {
+        entry& elem = get(prefix_hash);
+        if (elem.scanned == version_)
+          return false;
+        elem.scanned = version_;
+        return true;
+      }
+
+      //! Remove `tx` because it was mined.
+      void erase(const cryptonote::transaction& tx)
+      {
+        txes_.erase(cryptonote::get_transaction_prefix_hash(tx));
+      }
+
+      //! Remove transactions that the daemon has dropped from its txpool.
+      void expire()
+      {
+        const auto now = std::chrono::steady_clock::now();
+        for (auto elem = txes_.begin(); elem != txes_.end(); )
+        {
+          if (std::chrono::seconds{CRYPTONOTE_MEMPOOL_TX_LIVETIME} <= now - elem->second.added)
+            elem = txes_.erase(elem);
+          else
+            ++elem;
+        }
+      }
+
+      //! \return True if tx hash is unknown and `get_transaction_pool` was not tried.
+      bool needs_tx_hash(const crypto::hash& prefix_hash) const
+      {
+        const auto elem = txes_.find(prefix_hash);
+        return elem == txes_.end() || (!elem->second.tx_hash && !elem->second.fetched);
+      }
+
+      //! Add tx hashes from a `get_transaction_pool` requested for `prefix_hash`.
+      void add_tx_hashes(const std::vector<cryptonote::rpc::tx_in_pool>& txes, const crypto::hash& prefix_hash)
+      {
+        for (const auto& tx : txes)
+          get(cryptonote::get_transaction_prefix_hash(tx.tx)).tx_hash = tx.tx_hash;
+        get(prefix_hash).fetched = true;
+      }
+
+      //! \return Tx hash for `prefix_hash`, or null if unknown.
+      const crypto::hash* find_tx_hash(const crypto::hash& prefix_hash) const
+      {
+        const auto elem = txes_.find(prefix_hash);
+        if (elem == txes_.end() || !elem->second.tx_hash)
+          return nullptr;
+        return std::addressof(*elem->second.tx_hash);
+      }
+    };
+
+    struct send_webhook
+    {
+      db::storage const& disk_;
+      rpc::client& client_;
+      net::ssl_verification_t verify_mode_;
+      txpool_cache& txpool_;
+
+      bool operator()(lws::account& user, const db::output& out)
+      {
+        /* Upstream monerod does not send all fields for a transaction, so
+           mempool notifications cannot compute tx_hash correctly (it is not
+           sent separately, a further blunder). Instead, if there are matching
+           outputs with webhooks, fetch mempool to compare tx_prefix_hash and
+           then use corresponding tx_hash. */
+        const db::webhook_key key{user.id(), db::webhook_type::tx_confirmation};
+        std::vector<db::webhook_value> hooks{};
+        {
+          auto reader = disk_.start_read();
+          if (!reader)
+          {
+            MERROR("Unable to lookup webhook on tx in pool: " << reader.error().message());
+            return false;
+          }
+          auto found = reader->find_webhook(key, out.payment_id.short_);
+          if (!found)
+          {
+            MERROR("Failed db lookup for webhooks: " << found.error().message());
+            return false;
+          }
+          hooks = std::move(*found);
+        }
+
+        if (!hooks.empty() && txpool_.needs_tx_hash(out.tx_prefix_hash))
+        {
+          cryptonote::rpc::GetTransactionPool::Request req{};
+          if (!send(client_, rpc::client::make_message("get_transaction_pool", req)))
+          {
+            MERROR("Unable to compute tx hash for webhook, aborting");
+            return false;
+          }
+          auto resp = client_.get_message(std::chrono::seconds{3});
+          if (!resp)
+          {
+            MERROR("Unable to get txpool: " << resp.error().message());
+            return false;
+          }
+
+          auto txpool = rpc::parse_json_response<rpc::get_transaction_pool>(std::move(*resp));
+          if (!txpool)
+            MONERO_THROW(txpool.error(), "Failed fetching transaction pool");
+          txpool_.add_tx_hashes(txpool->transactions, out.tx_prefix_hash);
+        }
+
+        std::vector<db::webhook_tx_confirmation> events{};
+        for (auto& hook : hooks)
+        {
+          events.push_back(db::webhook_tx_confirmation{key, std::move(hook), out});
+          events.back().value.second.confirmations = 0;
+
+          const crypto::hash* const hash = txpool_.find_tx_hash(out.tx_prefix_hash);
+          if (hash)
+            events.back().tx_info.link.tx_hash = *hash;
+          else
+            events.pop_back(); //cannot compute tx_hash
+        }
+        send_payment_hook(client_, epee::to_span(events), verify_mode_);
+        return true;
+      }
+    };
+
+    /*!
+      Reload subaddress keys for each of `users` whose key count in `disk`
+      differs from the in-memory copy. Subaddresses are never removed, so a
+      matching count means the keys are current. */
+    void refresh_subaddresses(epee::span<lws::account> users, db::storage const& disk)
+    {
+      auto reader = MONERO_UNWRAP(disk.start_read());
+
+      db::cursor::subaddress_indexes cur = nullptr;
+      for (lws::account& user : users)
+      {
+        auto keys = MONERO_UNWRAP(reader.get_subaddress_indexes(user.id(), std::move(cur)));
+        const std::size_t count = keys.count();
+        if (count != user.subaddress_count())
+        {
+          std::vector<db::subaddress_map> copy{};
+          copy.reserve(count);
+          for (auto key = keys.make_iterator(); !key.is_end(); ++key)
+            copy.push_back(key.get_value<db::subaddress_map>());
+          user.set_subaddresses(std::move(copy));
+        }
+        cur = keys.give_cursor();
+      }
+    }
+
+    //! Transaction information shared by every account scan of a tx.
+    struct scan_tx
+    {
+      db::block_id height;
+      std::uint64_t timestamp;
+      crypto::hash hash;
+      cryptonote::transaction const* tx;
+      std::vector<std::uint64_t> const* out_ids;
+      cryptonote::tx_extra_pub_key key;
+      boost::optional<cryptonote::tx_extra_nonce> extra_nonce;
+      std::pair<std::uint8_t, db::output::payment_id_> payment_id;
+      cryptonote::tx_extra_additional_pub_keys additional_tx_pub_keys;
+      db::extra ext;
+      std::uint32_t mixin;
+    };
+
+    //! Parse tx extra and inputs of `out.tx`. \return False if tx cannot be scanned.
+    bool prepare_tx(scan_tx& out, const bool enable_subaddresses)
+    {
+      cryptonote::transaction const& tx = *out.tx;
+      if (2 < tx.version)
+        throw std::runtime_error{"Unsupported tx version"};
+
+      {
+        std::vector<cryptonote::tx_extra_field> extra;
+        cryptonote::parse_tx_extra(tx.extra, extra);
+        // allow partial parsing of tx extra (similar to wallet2.cpp)
+
+        if (!cryptonote::find_tx_extra_field_by_type(extra, out.key))
+          return false;
+
+        out.extra_nonce.emplace();
+        if (cryptonote::find_tx_extra_field_by_type(extra, *out.extra_nonce))
+        {
+          if (cryptonote::get_payment_id_from_tx_extra_nonce(out.extra_nonce->nonce, out.payment_id.second.long_))
+            out.payment_id.first = sizeof(crypto::hash);
+        }
+        else
+          out.extra_nonce = boost::none;
+
+        // additional tx pub keys present when there are 3+ outputs in a tx involving subaddresses
+        if (enable_subaddresses)
+          cryptonote::find_tx_extra_field_by_type(extra, out.additional_tx_pub_keys);
+      } // destruct `extra` vector
+
+      for (auto const& in : tx.vin)
+      {
+        cryptonote::txin_to_key const* const in_data =
+          boost::get<cryptonote::txin_to_key>(std::addressof(in));
+        if (in_data)
+        {
+          out.mixin = boost::numeric_cast<std::uint32_t>(
+            std::max(std::size_t(1), in_data->key_offsets.size()) - 1
+          );
+        }
+        else if (boost::get<cryptonote::txin_gen>(std::addressof(in)))
+          out.ext = db::extra(out.ext | db::coinbase_output);
       }
       return true;
     }
 
-    void send_payment_hook(rpc::client& client, const epee::span<const db::webhook_tx_confirmation> events, net::ssl_verification_t verify_mode)
-    {
-      rpc::send_webhook(client, events, "json-full-payment_hook:", "msgpack-full-payment_hook:", std::chrono::seconds{5}, verify_mode);
-    }
+    /*!
+      Maps output ids to the positions of accounts that can spend them, so
+      each ring member costs a single probe instead of a search in every
+      account. */
+    class spendable_index
+    {
+      struct hash_output_id
+      {
+        std::size_t operator()(db::output_id const& id) const noexcept
+        {
+          return lws::account::spendable_traits::hash(id);
+        }
+      };
+
+      std::unordered_multimap<db::output_id, std::size_t, hash_output_id> map_;
+
+    public:
+      spendable_index()
+        : map_()
+      {}
+
+      //! Add all spendable outputs of `users`, at positions starting with `offset`.
+      void add(epee::span<const lws::account> users, const std::size_t offset)
+      {
+        for (std::size_t user = 0; user < users.size(); ++user)
+        {
+          for (auto const& spendable : users[user].spendable())
+            map_.emplace(spendable.first, offset + user);
+        }
+      }
+
+      //! Add `id` as spendable by account at `position`.
+      void add(db::output_id const& id, const std::size_t position)
+      {
+        map_.emplace(id, position);
+      }
+
+      //! Move all entries from `source` into `this`.
+      void merge(spendable_index& source)
+      {
+        map_.merge(source.map_);
+      }
+
+      //! Call `f(position)` for every account that can spend `id`.
+      template<typename F>
+      void find(db::output_id const& id, F f) const
+      {
+        const auto range = map_.equal_range(id);
+        for (auto entry = range.first; entry != range.second; ++entry)
+          f(entry->second);
+      }
+    };
+
+    /*!
+      Find possible spends in `data` by `users` at positions [`first`, `last`)
+      in `index`. Accounts that have already scanned `data.height` are
+      skipped. */
+    void scan_spends(
+      epee::span<lws::account> users,
+      const std::size_t first,
+      const std::size_t last,
+      spendable_index const& index,
+      scan_tx const& data,
+      const std::function<void(lws::account&, const db::spend&)>& spend_action)
+    {
+      for (auto const& in : data.tx->vin)
+      {
+        cryptonote::txin_to_key const* const in_data =
+          boost::get<cryptonote::txin_to_key>(std::addressof(in));
+        if (!in_data)
+          continue; // to next input
+
+        const std::uint32_t mixin = boost::numeric_cast<std::uint32_t>(
+          std::max(std::size_t(1), in_data->key_offsets.size()) - 1
+        );
+
+        std::uint64_t goffset = 0;
+        for (std::uint64_t offset : in_data->key_offsets)
+        {
+          goffset += offset;
+          const db::output_id id{in_data->amount, goffset};
+          index.find(id, [&] (const std::size_t position)
+          {
+            if (position < first || last <= position)
+              return;
+
+            lws::account& user = users[position];
+            if (data.height <= user.scan_height())
+              return;
+
+            const boost::optional<db::address_index> subaccount = user.get_spendable(id);
+            if (!subaccount)
+              return;
+
+            spend_action(
+              user,
+              db::spend{
+                db::transaction_link{data.height, data.hash},
+                in_data->k_image,
+                id,
+                data.timestamp,
+                data.tx->unlock_time,
+                mixin,
+                {0, 0, 0}, // reserved
+                data.payment_id.first,
+                data.payment_id.second.long_,
+                *subaccount
+              }
+            );
+          });
+        } // for all ring members
+      }
+    }
+
+    //! Output of a tx that passed the view tag check for an account.
+    struct output_candidate
+    {
+      std::size_t user;
+      std::size_t index;
+    };
+
+    //! Output received by an account, not yet added to it.
+    struct found_output
+    {
+      std::size_t user;
+      std::size_t tx;
+      db::output out;
+    };
+
+    /*!
+      Inspect `candidates` (all for `user`, in output order) of `data`, which
+      is at position `tx` in its batch. Received outputs are appended to
+      `found`. */
+    void scan_account_outputs(
+      lws::account const& user,
+      scan_tx const& data,
+      const std::size_t tx_position,
+      const crypto::key_derivation& derived,
+      epee::span<const crypto::key_derivation> additional_derivations,
+      epee::span<const output_candidate> candidates,
+      boost::optional<crypto::hash>& prefix_hash,
+      std::vector<found_output>& found)
+    {
+      cryptonote::transaction const& tx = *data.tx;
+
+      db::extra ext = data.ext;
+      std::pair<std::uint8_t, db::output::payment_id_> payment_id = data.payment_id;
+
+      for (output_candidate const& candidate : candidates)
+      {
+        const std::size_t index = candidate.index;
+        auto const& out = tx.vout.at(index);
+
+        crypto::public_key out_pub_key;
+        if (!cryptonote::get_output_public_key(out, out_pub_key))
+          continue; // to next output
+
+        bool found_pub = false;
+        db::address_index account_index{db::major_index::primary, db::minor_index::primary};
+        crypto::key_derivation active_derived{};
+        crypto::public_key active_pub{};
+
+        // inspect the additional and traditional keys
+        for (std::size_t attempt = 0; attempt < 2; ++attempt)
+        {
+          if (attempt == 0)
+          {
+            active_derived = derived;
+            active_pub = data.key.pub_key;
+          }
+          else if (!additional_derivations.empty())
+          {
+            active_derived = additional_derivations[index];
+            active_pub = data.additional_tx_pub_keys.data.at(index);
+          }
+          else
+            break; // inspection loop
+
+          crypto::public_key derived_pub;
+          if (!crypto::wallet::derive_subaddress_public_key(out_pub_key, active_derived, index, derived_pub))
+            continue; // to next available active_derived
+
+          if (user.spend_public() != derived_pub)
+          {
+            const boost::optional<db::address_index> match =
+              user.find_subaddress(derived_pub);
+            if (!match)
+              continue; // to next available active_derived
+            found_pub = true;
+            account_index = *match;
+            break; // additional_derivations loop
+          }
+          else
+          {
+            found_pub = true;
+            break; // additional_derivations loop
+          }
+        }
+
+        if (!found_pub)
+          continue; // to next output
+
+        if (!prefix_hash)
+        {
+          prefix_hash.emplace();
+          cryptonote::get_transaction_prefix_hash(tx, *prefix_hash);
+        }
+
+        std::uint64_t amount = out.amount;
+        rct::key mask = rct::identity();
+        if (!amount && !(ext & db::coinbase_output) && 1 < tx.version)
+        {
+          const bool bulletproof2 = (rct::RCTTypeBulletproof2 <= tx.rct_signatures.type);
+          const auto decrypted = lws::decode_amount(
+            tx.rct_signatures.outPk.at(index).mask, tx.rct_signatures.ecdhInfo.at(index), active_derived, index, bulletproof2
+          );
+          if (!decrypted)
+          {
+            MWARNING(user.address() << " failed to decrypt amount for tx " << data.hash << ", skipping output");
+            continue; // to next output
+          }
+          amount = decrypted->first;
+          mask = decrypted->second;
+          ext = db::extra(ext | db::ringct_output);
+        }
+
+        if (data.extra_nonce)
+        {
+          if (!payment_id.first && cryptonote::get_encrypted_payment_id_from_tx_extra_nonce(data.extra_nonce->nonce, payment_id.second.short_))
+          {
+            payment_id.first = sizeof(crypto::hash8);
+            lws::decrypt_payment_id(payment_id.second.short_, active_derived);
+          }
+        }
+        found.push_back(found_output{
+          candidate.user,
+          tx_position,
+          db::output{
+            db::transaction_link{data.height, data.hash},
+            db::output::spend_meta_{
+              db::output_id{tx.version < 2 ? out.amount : 0, data.out_ids->at(index)},
+              amount,
+              data.mixin,
+              boost::numeric_cast<std::uint32_t>(index),
+              active_pub
+            },
+            data.timestamp,
+            tx.unlock_time,
+            *prefix_hash,
+            out_pub_key,
+            mask,
+            {0, 0, 0, 0, 0, 0, 0}, // reserved bytes
+            db::pack(ext, payment_id.first),
+            payment_id.second,
+            cryptonote::get_tx_fee(tx),
+            account_index
+          }
+        });
+      } // for all candidates
+    }
+
+    //! \return True if `data` has an additional tx key for every output.
+    bool has_additional_keys(scan_tx const& data) noexcept
+    {
+      const std::size_t count = data.additional_tx_pub_keys.data.size();
+      return count && count == data.tx->vout.size();
+    }
+
+    /*!
+      Find outputs in `txes` received by `users` that have not scanned the
+      height of each tx. The view tags of consecutive txes are kept as one
+      column, and a column of tags derived by each account is compared
+      against it with `lws::match_view_tags` before any subaddress lookup.
+      Key derivations for every account are computed as one batch per tx,
+      and are computed again for a single account when one of its tags
+      matches. `users` are not modified.
+
+      \return Received outputs ordered by tx, then by account. */
+    std::vector<found_output> scan_outputs(epee::span<const lws::account> users, epee::span<const scan_tx> txes)
+    {
+      std::vector<found_output> found;
+      if (users.empty())
+        return found;
+
+      const std::size_t column_max = std::max(
+        view_tag_column_min, std::min(view_tag_column_max, view_tag_bytes_max / users.size())
+      );
+
+      std::vector<std::size_t> offsets;   // position of first output, per tx in column
+      std::vector<std::uint8_t> tags;
+      std::vector<bool> tagged;
+
+      // stored as `[user * tags.size() + position]`, `~tag` never matches
+      std::vector<std::uint8_t> expected;
+      std::vector<std::uint8_t> expected_additional;
+
+      std::vector<std::size_t> active;
+      std::vector<std::array<std::int8_t, 64> const*> view_keys;
+      std::vector<crypto::key_derivation> derived;
+      std::vector<crypto::key_derivation> next;
+      std::vector<crypto::key_derivation> additional_derivations;
+      std::vector<std::uint32_t> hits;
+      std::vector<output_candidate> candidates;
+      std::vector<boost::optional<crypto::hash>> prefix_hashes;
+
+      for (std::size_t first = 0; first < txes.size(); )
+      {
+        // view tags of consecutive txes as one column
+        std::size_t last = first;
+        bool additional_column = false;
+        offsets.assign(1, 0);
+        tags.clear();
+        tagged.clear();
+        do
+        {
+          for (auto const& out : txes[last].tx->vout)
+          {
+            const boost::optional<crypto::view_tag> tag =
+              cryptonote::get_output_view_tag(out);
+            tags.push_back(tag ? std::uint8_t(tag->data) : 0);
+            tagged.push_back(bool(tag));
+          }
+          additional_column |= has_additional_keys(txes[last]);
+          offsets.push_back(tags.size());
+          ++last;
+        } while (last < txes.size() && tags.size() + txes[last].tx->vout.size() <= column_max);
+
+        const std::size_t width = tags.size();
+        const std::size_t first_tx = first;
+        first = last;
+        if (!width)
+          continue; // to next column
+
+        const auto no_match = [] (const std::uint8_t tag) { return std::uint8_t(~tag); };
+        expected.resize(users.size() * width);
+        for (std::size_t user = 0; user < users.size(); ++user)
+          std::transform(tags.begin(), tags.end(), expected.begin() + user * width, no_match);
+        if (additional_column)
+          expected_additional = expected;
+
+        // outputs without a view tag always get the full check
+        const auto derive_tags = [&] (std::uint8_t* out, const std::size_t offset, const std::size_t count, const crypto::key_derivation* derivations, const std::size_t stride, const bool match_untagged)
+        {
+          for (std::size_t index = 0; index < count; ++index)
+          {
+            if (!tagged[offset + index])
+            {
+              if (match_untagged)
+                out[offset + index] = tags[offset + index];
+              continue; // to next output
+            }
+            crypto::view_tag tag{};
+            crypto::derive_view_tag(derivations[index * stride], index, tag);
+            out[offset + index] = std::uint8_t(tag.data);
+          }
+        };
+
+        for (std::size_t tx = first_tx; tx < last; ++tx)
+        {
+          scan_tx const& data = txes[tx];
+          const std::size_t offset = offsets[tx - first_tx];
+          const std::size_t count = data.tx->vout.size();
+
+          active.clear();
+          view_keys.clear();
+          for (std::size_t user = 0; user < users.size(); ++user)
+          {
+            if (users[user].scan_height() < data.height)
+            {
+              active.push_back(user);
+              view_keys.push_back(std::addressof(users[user].view_key_digits()));
+            }
+          }
+
+          if (!count || active.empty() || !lws::generate_key_derivations(derived, data.key.pub_key, epee::to_span(view_keys)))
+            continue; // to next tx
+
+          for (std::size_t user = 0; user < active.size(); ++user)
+            derive_tags(expected.data() + active[user] * width, offset, count, std::addressof(derived[user]), 0, true);
+
+          // stored as `[user * count + index]`, keys only present with subaddresses enabled
+          if (has_additional_keys(data))
+          {
+            additional_derivations.resize(active.size() * count);
+            bool valid = true;
+            for (std::size_t index = 0; index < count && valid; ++index)
+            {
+              valid = lws::generate_key_derivations(next, data.additional_tx_pub_keys.data[index], epee::to_span(view_keys));
+              for (std::size_t user = 0; user < active.size() && valid; ++user)
+                additional_derivations[user * count + index] = next[user];
+            }
+
+            for (std::size_t user = 0; user < active.size() && valid; ++user)
+              derive_tags(expected_additional.data() + active[user] * width, offset, count, additional_derivations.data() + user * count, 1, false);
+          }
+        }
+
+        prefix_hashes.assign(last - first_tx, boost::none);
+        for (std::size_t user = 0; user < users.size(); ++user)
+        {
+          hits.clear();
+          lws::match_view_tags(hits, {expected.data() + user * width, width}, epee::to_span(tags));
+          if (additional_column)
+          {
+            lws::match_view_tags(hits, {expected_additional.data() + user * width, width}, epee::to_span(tags));
+            std::sort(hits.begin(), hits.end());
+            hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+          }
+
+          // tags rarely match, so derivations are not kept for every account
+          for (auto hit = hits.begin(); hit != hits.end(); )
+          {
+            const std::size_t tx =
+              std::upper_bound(offsets.begin(), offsets.end(), std::size_t(*hit)) - offsets.begin() - 1;
+            scan_tx const& data = txes[first_tx + tx];
+
+            candidates.clear();
+            for ( ; hit != hits.end() && *hit < offsets[tx + 1]; ++hit)
+              candidates.push_back(output_candidate{user, *hit - offsets[tx]});
 
-    std::size_t get_target_time(db::block_id height)
-    {
-      const hardfork_t* fork = nullptr;
-      switch (config::network)
+            view_keys.assign(1, std::addressof(users[user].view_key_digits()));
+            if (!lws::generate_key_derivations(derived, data.key.pub_key, epee::to_span(view_keys)))
+              continue; // to next tx with hits
+
+            additional_derivations.clear();
+            if (has_additional_keys(data))
+            {
+              for (auto const& key : data.additional_tx_pub_keys.data)
+              {
+                if (!lws::generate_key_derivations(next, key, epee::to_span(view_keys)))
+                {
+                  additional_derivations.clear();
+                  break; // additional keys loop
+                }
+                additional_derivations.push_back(next.front());
+              }
+            }
+
+            scan_account_outputs(
+              users[user],
+              data,
+              first_tx + tx,
+              derived.front(),
+              epee::to_span(additional_derivations),
+              epee::to_span(candidates),
+              prefix_hashes[tx],
+              found
+            );
+          }
+        }
+      } // for each column
+
+      std::stable_sort(found.begin(), found.end(), [] (found_output const& left, found_output const& right)
       {
-      case cryptonote::network_type::MAINNET:
-        if (num_mainnet_hard_forks < 2)
-          MONERO_THROW(error::bad_blockchain, "expected more mainnet forks");
-        fork = mainnet_hard_forks;
-        break;     
-      case cryptonote::network_type::TESTNET:
-         if (num_testnet_hard_forks < 2)
-          MONERO_THROW(error::bad_blockchain, "expected more testnet forks");
-        fork = testnet_hard_forks;
-        break; 
-      case cryptonote::network_type::STAGENET:
-         if (num_stagenet_hard_forks < 2)
-          MONERO_THROW(error::bad_blockchain, "expected more stagenet forks");
-        fork = stagenet_hard_forks;
-        break;
-      default:
-        MONERO_THROW(error::bad_blockchain, "chain type not support with full sync"); 
-      } 
-      // this is hardfork version 2
-      return height < db::block_id(fork[1].height) ?
-        DIFFICULTY_TARGET_V1 : DIFFICULTY_TARGET_V2;
+        return left.tx < right.tx;
+      });
+      return found;
     }
 
-    //! For difficulty vectors only
-    template<typename T> 
-    void update_window(T& vec)
+    void scan_transaction_base(
+      epee::span<lws::account> users,
+      spendable_index const& index,
+      scan_tx const& data,
+      std::function<void(lws::account&, const db::spend&)> spend_action,
+      std::function<bool(lws::account&, const db::output&)> output_action)
     {
-      // should only have one to pop each time
-      while (DIFFICULTY_BLOCKS_COUNT < vec.size())
-        vec.erase(vec.begin());
-    };
+      scan_spends(users, 0, users.size(), index, data, spend_action);
 
-    void send_spend_hook(rpc::client& client, const epee::span<const db::webhook_tx_spend> events, net::ssl_verification_t verify_mode)
-    {
-      rpc::send_webhook(client, events, "json-full-spend_hook:", "msgpack-full-spend_hook:", std::chrono::seconds{5}, verify_mode);
+      for (found_output const& found : scan_outputs(users, {std::addressof(data), 1}))
+      {
+        if (!output_action(users[found.user], found.out))
+          MWARNING("Output not added, duplicate public key encountered");
+      }
     }
 
-    struct by_height
+    /*!
+      Run `task(0)` through `task(count - 1)` on the shared compute threadpool.
+      Each worker claims the next unstarted task when it finishes one, so a
+      slow task does not hold up the remaining ones. The calling thread also
+      runs tasks, and then waits only for tasks already claimed by a worker.
+      `tools::threadpool::waiter` is not used, because its `wait()` runs any
+      queued job (i.e. RandomX checks from `pow_verifier`) on the calling
+      thread. The first exception thrown by a task is re-thrown. */
+    template<typename F>
+    void run_tasks(const std::size_t count, F task)
     {
-      bool operator()(account const& left, account const& right) const noexcept
+      struct state
       {
-        return left.scan_height() < right.scan_height();
-      }
-    };
+        std::atomic<std::size_t> next;
+        boost::mutex sync;
+        boost::condition_variable done;
+        std::size_t finished; //!< Tasks completed or skipped after an error
+        std::exception_ptr error;
+      };
+
+      if (!count)
+        return;
 
-    struct add_spend
-    {
-      void operator()(lws::account& user, const db::spend& spend) const
-      { user.add_spend(spend); }
-    };
-    struct add_output
-    {
-      bool operator()(lws::account& user, const db::output& out) const
-      { return user.add_out(out); }
-    };
+      tools::threadpool& pool = tools::threadpool::getInstanceForCompute();
 
-    struct null_spend
-    {
-      void operator()(lws::account&, const db::spend&) const noexcept
-      {}
-    };
-    struct send_webhook
-    {
-      db::storage const& disk_;
-      rpc::client& client_;
-      net::ssl_verification_t verify_mode_;
-      std::unordered_map<crypto::hash, crypto::hash> txpool_;
+      // workers dequeued after the last task finished only touch `shared`
+      const auto shared = std::make_shared<state>();
+      shared->next = 0;
+      shared->finished = 0;
 
-      bool operator()(lws::account& user, const db::output& out)
+      F* const task_ptr = std::addressof(task);
+      const auto worker = [shared, task_ptr, count] ()
       {
-        /* Upstream monerod does not send all fields for a transaction, so
-           mempool notifications cannot compute tx_hash correctly (it is not
-           sent separately, a further blunder). Instead, if there are matching
-           outputs with webhooks, fetch mempool to compare tx_prefix_hash and
-           then use corresponding tx_hash. */
-        const db::webhook_key key{user.id(), db::webhook_type::tx_confirmation};
-        std::vector<db::webhook_value> hooks{};
+        for (std::size_t i = shared->next++; i < count; i = shared->next++)
         {
-          auto reader = disk_.start_read();
-          if (!reader)
+          std::exception_ptr error{};
+          try
           {
-            MERROR("Unable to lookup webhook on tx in pool: " << reader.error().message());
-            return false;
+            (*task_ptr)(i);
           }
-          auto found = reader->find_webhook(key, out.payment_id.short_);
-          if (!found)
+          catch (...)
           {
-            MERROR("Failed db lookup for webhooks: " << found.error().message());
-            return false;
+            error = std::current_exception();
           }
-          hooks = std::move(*found);
-        }
 
-        if (!hooks.empty() && txpool_.empty())
-        {
-          cryptonote::rpc::GetTransactionPool::Request req{};
-          if (!send(client_, rpc::client::make_message("get_transaction_pool", req)))
+          std::size_t finished = 1;
+          if (error)
           {
-            MERROR("Unable to compute tx hash for webhook, aborting");
-            return false;
+            // unclaimed tasks are skipped
+            const std::size_t claimed = shared->next.exchange(count);
+            finished += count - std::min(count, claimed);
           }
-          auto resp = client_.get_message(std::chrono::seconds{3});
-          if (!resp)
+
+          bool last = false;
           {
-            MERROR("Unable to get txpool: " << resp.error().message());
-            return false;
+            const boost::lock_guard<boost::mutex> lock{shared->sync};
+            if (error && !shared->error)
+              shared->error = error;
+            shared->finished += finished;
+            last = (shared->finished == count);
           }
-
-          auto txpool = rpc::parse_json_response<rpc::get_transaction_pool>(std::move(*resp));
-          if (!txpool)
-            MONERO_THROW(txpool.error(), "Failed fetching transaction pool");
-          for (auto& tx : txpool->transactions)
-            txpool_.emplace(get_transaction_prefix_hash(tx.tx), tx.tx_hash);
+          if (last)
+            shared->done.notify_all();
         }
+      };
+
+      const std::size_t workers = std::min(count, std::size_t(pool.get_max_concurrency()));
+      for (std::size_t i = 1; i < workers; ++i)
+        pool.submit(nullptr, worker);
+      worker();
+
+      boost::unique_lock<boost::mutex> lock{shared->sync};
+      while (shared->finished < count)
+        shared->done.wait(lock);
+      if (shared->error)
+        std::rethrow_exception(shared->error);
+    }
 
-        std::vector<db::webhook_tx_confirmation> events{};
-        for (auto& hook : hooks)
-        {
-          events.push_back(db::webhook_tx_confirmation{key, std::move(hook), out});
-          events.back().value.second.confirmations = 0;
-
-          const auto hash = txpool_.find(out.tx_prefix_hash);
-          if (hash != txpool_.end())
-            events.back().tx_info.link.tx_hash = hash->second;
-          else
-            events.pop_back(); //cannot compute tx_hash
-        }
-        send_payment_hook(client_, epee::to_span(events), verify_mode_);
-        return true;
-      }
+    //! Block PoW to verify after the serial difficulty and timestamp checks.
+    struct pow_check
+    {
+      std::string blob; //!< From `cryptonote::get_block_hashing_blob`
+      crypto::hash id;
+      crypto::hash seed;
+      db::block_difficulty::unsigned_int diff;
+      db::block_id height;
+      std::uint8_t major_version;
     };
 
-    struct subaddress_reader
+    //! `crypto::rx_set_main_seedhash`, unless `seed` was the last main seed applied.
+    void set_main_seed(const crypto::hash& seed, const std::size_t threads)
     {
-      expect<db::storage_reader> reader;
-      db::cursor::subaddress_indexes cur;
+      static boost::mutex sync;
+      static boost::optional<crypto::hash> applied;
+
+      const boost::lock_guard<boost::mutex> lock{sync};
+      if (applied && *applied == seed)
+        return;
+      crypto::rx_set_main_seedhash(seed.data, threads);
+      applied = seed;
+    }
 
-      subaddress_reader(db::storage const& disk, const bool enable_subaddresses)
-        : reader(common_error::kInvalidArgument), cur(nullptr)
+    /*!
+      Verifies block PoW with tasks on the compute threadpool, so slow hashes
+      run in parallel while the calling thread continues (scanning). Monero
+      keeps one RandomX cache per seed hash, shared by every thread. With
+      `fast`, the newest seed becomes the RandomX main seed, which uses the
+      full dataset when monero allows it. Only `wait()` blocks.
+
+      With a `pow_ledger`, blocks claimed by another scan thread are not
+      hashed again; `wait()` uses the verdict from that thread instead. */
+    class pow_verifier
+    {
+      pow_ledger* const ledger_;
+      std::vector<pow_check> checks_;
+      std::vector<pow_check> others_;   //!< Claimed by another thread
+      std::vector<std::uint8_t> valid_; //!< Per `checks_`, written by one task each
+      std::atomic<std::size_t> next_;
+      std::atomic<std::uint64_t> failed_; //!< Height + 1 of a failed check, or 0
+      tools::threadpool::waiter waiter_;
+      bool started_;
+      bool finished_;
+
+      static bool verify(const pow_check& check)
       {
-        if (enable_subaddresses)
+        const crypto::hash pow = get_block_longhash(check.blob, check.height, check.major_version, check.seed);
+        return cryptonote::check_hash(pow, check.diff);
+      }
+
+      void work() noexcept
+      {
+        for (std::size_t i = next_++; i < checks_.size() && !failed_; i = next_++)
         {
-          reader = disk.start_read();
-          if (!reader)
-            MERROR("Subadress lookup failure: " << reader.error().message());
+          valid_[i] = verify(checks_[i]);
+          if (!valid_[i])
+            failed_ = std::uint64_t(checks_[i].height) + 1;
         }
       }
-    };
 
-    void scan_transaction_base(
-      epee::span<lws::account> users,
-      const db::block_id height,
-      const std::uint64_t timestamp,
-      crypto::hash const& tx_hash,
-      cryptonote::transaction const& tx,
-      std::vector<std::uint64_t> const& out_ids,
-      subaddress_reader& reader,
-      std::function<void(lws::account&, const db::spend&)> spend_action,
-      std::function<bool(lws::account&, const db::output&)> output_action)
-    {
-      if (2 < tx.version)
-        throw std::runtime_error{"Unsupported tx version"};
+      //! Give verdicts of `checks_` to other threads.
+      void finish(const bool complete) noexcept
+      {
+        if (finished_ || !ledger_)
+          return;
+        finished_ = true;
+        for (std::size_t i = 0; i < checks_.size(); ++i)
+        {
+          pow_ledger::verdict result = pow_ledger::verdict::released;
+          if (complete && i < valid_.size() && i < next_)
+            result = valid_[i] ? pow_ledger::verdict::valid : pow_ledger::verdict::invalid;
+          ledger_->finish(checks_[i].id, result);
+        }
+      }
 
-      cryptonote::tx_extra_pub_key key;
-      boost::optional<crypto::hash> prefix_hash;
-      boost::optional<cryptonote::tx_extra_nonce> extra_nonce;
-      std::pair<std::uint8_t, db::output::payment_id_> payment_id;
-      cryptonote::tx_extra_additional_pub_keys additional_tx_pub_keys;
-      std::vector<crypto::key_derivation> additional_derivations;
+    public:
+      explicit pow_verifier(pow_ledger* ledger)
+        : ledger_(ledger),
+          checks_(),
+          others_(),
+          valid_(),
+          next_(0),
+          failed_(0),
+          waiter_(tools::threadpool::getInstanceForCompute()),
+          started_(false),
+          finished_(false)
+      {}
 
+      pow_verifier(const pow_verifier&) = delete;
+      pow_verifier& operator=(const pow_verifier&) = delete;
+
+      //! Releases unfinished claims, so waiting threads verify themselves.
+      ~pow_verifier() noexcept
       {
-        std::vector<cryptonote::tx_extra_field> extra;
-        cryptonote::parse_tx_extra(tx.extra, extra);
-        // allow partial parsing of tx extra (similar to wallet2.cpp)
+        waiter_.wait();
+        finish(false);
+      }
+
+      bool empty() const noexcept { return checks_.empty() && others_.empty(); }
+
+      void push(pow_check check)
+      {
+        assert(!started_);
+        if (ledger_ && !ledger_->claim(check.id, check.height))
+          others_.push_back(std::move(check));
+        else
+          checks_.push_back(std::move(check));
+      }
 
-        if (!cryptonote::find_tx_extra_field_by_type(extra, key))
+      //! Start verifying every `push`ed check.
+      void start(const bool fast)
+      {
+        assert(!started_);
+        started_ = true;
+        if (checks_.empty())
           return;
 
-        extra_nonce.emplace();
-        if (cryptonote::find_tx_extra_field_by_type(extra, *extra_nonce))
+        valid_.resize(checks_.size());
+        tools::threadpool& pool = tools::threadpool::getInstanceForCompute();
+        if (fast && RX_BLOCK_VERSION <= checks_.back().major_version)
+          set_main_seed(checks_.back().seed, pool.get_max_concurrency());
+
+        const std::size_t workers = std::min(checks_.size(), std::size_t(pool.get_max_concurrency()));
+        for (std::size_t i = 0; i < workers; ++i)
+          pool.submit(std::addressof(waiter_), [this] () { work(); });
+      }
+
+      //! \return Height of a block that failed PoW, if any.
+      boost::optional<db::block_id> wait()
+      {
+        if (!started_)
+          start(false);
+        waiter_.wait();
+        finish(!failed_);
+        if (failed_)
+          return db::block_id(failed_ - 1);
+
+        for (const pow_check& check : others_)
         {
-          if (cryptonote::get_payment_id_from_tx_extra_nonce(extra_nonce->nonce, payment_id.second.long_))
-            payment_id.first = sizeof(crypto::hash);
+          pow_ledger::verdict result = ledger_->wait(check.id);
+          if (result == pow_ledger::verdict::released)
+            result = verify(check) ? pow_ledger::verdict::valid : pow_ledger::verdict::invalid;
+          if (result != pow_ledger::verdict::valid)
+            return check.height;
         }
-        else
-          extra_nonce = boost::none;
+        return boost::none;
+      }
+    };
 
-        // additional tx pub keys present when there are 3+ outputs in a tx involving subaddresses
-        if (reader.reader)
-          cryptonote::find_tx_extra_field_by_type(extra, additional_tx_pub_keys);
-      } // destruct `extra` vector
+    /*!
+      Scans `txes` against `users` with tasks on the compute threadpool.
+      Outputs are found with a task per (tx range, account chunk), since
+      finding outputs does not change account state. Spends and outputs are
+      then applied in chain order with a task per account chunk. Received
+      outputs are added to `index` after all tasks complete. */
+    void scan_batch_pooled(epee::span<lws::account> users, spendable_index& index, epee::span<const scan_tx> txes)
+    {
+      if (users.empty() || txes.empty())
+        return;
 
-      for (account& user : users)
-      {
-        if (height <= user.scan_height())
-          continue; // to next user
+      const std::size_t tasks =
+        std::max(1u, tools::threadpool::getInstanceForCompute().get_max_concurrency()) * 4;
+      const std::size_t chunks = std::min(users.size(), tasks);
+      const std::size_t ranges = std::max(std::size_t(1), std::min(txes.size(), tasks / chunks));
 
-        crypto::key_derivation derived;
-        if (!crypto::wallet::generate_key_derivation(key.pub_key, user.view_key(), derived))
-          continue; // to next user
+      const auto chunk_begin = [&] (const std::size_t chunk) { return chunk * users.size() / chunks; };
+      const auto range_begin = [&] (const std::size_t range) { return range * txes.size() / ranges; };
+
+      std::vector<std::vector<found_output>> found(chunks * ranges);
+      run_tasks(found.size(), [&] (const std::size_t task)
+      {
+        const std::size_t chunk = task / ranges;
+        const std::size_t range = task % ranges;
+        std::vector<found_output>& results = found[task];
 
-        if (reader.reader && additional_tx_pub_keys.data.size() == tx.vout.size())
+        results = scan_outputs(
+          users.subspan(chunk_begin(chunk), chunk_begin(chunk + 1) - chunk_begin(chunk)),
+          txes.subspan(range_begin(range), range_begin(range + 1) - range_begin(range))
+        );
+        for (found_output& result : results)
         {
-          additional_derivations.resize(tx.vout.size());
-          std::size_t index = -1;
-          for (auto const& out: tx.vout)
-          {
-            ++index;
-            if (!crypto::wallet::generate_key_derivation(additional_tx_pub_keys.data[index], user.view_key(), additional_derivations[index]))
-            {
-              additional_derivations.clear();
-              break; // vout loop
-            }
-          }
+          result.user += chunk_begin(chunk);
+          result.tx += range_begin(range);
         }
+      });
 
-        db::extra ext{};
-        std::uint32_t mixin = 0;
-        for (auto const& in : tx.vin)
+      // `index` is shared by all tasks, so outputs received in this batch are tracked per chunk
+      std::vector<spendable_index> received(chunks);
+      run_tasks(chunks, [&] (const std::size_t chunk)
+      {
+        std::size_t range = 0;
+        std::size_t next = 0;
+        for (std::size_t tx = 0; tx < txes.size(); ++tx)
         {
-          cryptonote::txin_to_key const* const in_data =
-            boost::get<cryptonote::txin_to_key>(std::addressof(in));
-          if (in_data)
-          {
-            mixin = boost::numeric_cast<std::uint32_t>(
-              std::max(std::size_t(1), in_data->key_offsets.size()) - 1
-            );
+          scan_spends(users, chunk_begin(chunk), chunk_begin(chunk + 1), index, txes[tx], add_spend{});
+          scan_spends(users, chunk_begin(chunk), chunk_begin(chunk + 1), received[chunk], txes[tx], add_spend{});
 
-            std::uint64_t goffset = 0;
-            for (std::uint64_t offset : in_data->key_offsets)
+          // results are ordered by tx within a range, and ranges are ordered
+          while (range < ranges)
+          {
+            const std::vector<found_output>& results = found[chunk * ranges + range];
+            if (next == results.size())
             {
-              goffset += offset;
-              const boost::optional<db::address_index> subaccount =
-                user.get_spendable(db::output_id{in_data->amount, goffset});
-              if (!subaccount)
-                continue; // to next input
-
-              spend_action(
-                user,
-                db::spend{
-                  db::transaction_link{height, tx_hash},
-                  in_data->k_image,
-                  db::output_id{in_data->amount, goffset},
-                  timestamp,
-                  tx.unlock_time,
-                  mixin,
-                  {0, 0, 0}, // reserved
-                  payment_id.first,
-                  payment_id.second.long_,
-                  *subaccount
-                }
-              );
+              ++range;
+              next = 0;
+              continue;
             }
+            if (results[next].tx != tx)
+              break;
+            if (users[results[next].user].add_out(results[next].out))
+              received[chunk].add(results[next].out.spend_meta.id, results[next].user);
+            else
+              MWARNING("Output not added, duplicate public key encountered");
+            ++next;
           }
-          else if (boost::get<cryptonote::txin_gen>(std::addressof(in)))
-            ext = db::extra(ext | db::coinbase_output);
         }
+      });
 
-        std::size_t index = -1;
-        for (auto const& out : tx.vout)
+      for (spendable_index& chunk : received)
+        index.merge(chunk);
+    }
+
+    /*!
+      Scans `txes` against `users` on the calling thread. Spends and outputs
+      are applied in chain order, and received outputs are added to `index`. */
+    void scan_batch(epee::span<lws::account> users, spendable_index& index, epee::span<const scan_tx> txes)
+    {
+      const std::vector<found_output> found = scan_outputs(users, txes);
+      auto next = found.begin();
+      for (std::size_t tx = 0; tx < txes.size(); ++tx)
+      {
+        scan_spends(users, 0, users.size(), index, txes[tx], add_spend{});
+        for ( ; next != found.end() && next->tx == tx; ++next)
         {
-          ++index;
+          if (users[next->user].add_out(next->out))
+            index.add(next->out.spend_meta.id, next->user);
+          else
+            MWARNING("Output not added, duplicate public key encountered");
+        }
+      }
+    }
 
-          crypto::public_key out_pub_key;
-          if (!cryptonote::get_output_public_key(out, out_pub_key))
-            continue; // to next output
+    void scan_transactions(std::string&& txpool_msg, epee::span<lws::account> users, spendable_index const& index, txpool_cache& txpool, db::storage const& disk, rpc::client& client, const scanner_options& opts)
+    {
+      // uint64::max is for txpool
+      static const std::vector<std::uint64_t> fake_outs(
+        256, std::numeric_limits<std::uint64_t>::max()
+      );
+
+      const auto parsed = rpc::full_txpool_pub::from_json(std::move(txpool_msg));
+      if (!parsed)
+      {
+        MERROR("Failed parsing txpool pub: " << parsed.error().message());
+        return;
+      }
 
-          boost::optional<crypto::view_tag> view_tag_opt =
-            cryptonote::get_output_view_tag(out);
+      const auto time =
+        boost::numeric_cast<std::uint64_t>(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
 
-          const bool found_tag =
-            (!additional_derivations.empty() && cryptonote::out_can_be_to_acc(view_tag_opt, additional_derivations.at(index), index)) ||
-            cryptonote::out_can_be_to_acc(view_tag_opt, derived, index); 
+      txpool.expire();
+      send_webhook sender{disk, client, opts.webhook_verify, txpool};
+      for (const auto& tx : parsed->txes)
+      {
+        if (!txpool.mark_scanned(cryptonote::get_transaction_prefix_hash(tx)))
+          continue; // repeated in pub, and accounts are unchanged
 
-          if (!found_tag)
-            continue; // to next output
+        scan_tx data{db::block_id::txpool, time, crypto::hash{}, std::addressof(tx), std::addressof(fake_outs)};
+        if (prepare_tx(data, opts.enable_subaddresses))
+          scan_transaction_base(users, index, data, null_spend{}, sender);
+      }
+    }
+
+    void update_rates(rpc::context& ctx)
+    {
+      const expect<boost::optional<lws::rates>> new_rates = ctx.retrieve_rates();
+      if (!new_rates)
+        MERROR("Failed to retrieve exchange rates: " << new_rates.error().message());
+      else if (*new_rates)
+        MINFO("Updated exchange rates: " << *(*new_rates));
+    }
 
-          bool found_pub = false;
-          db::address_index account_index{db::major_index::primary, db::minor_index::primary};
-          crypto::key_derivation active_derived{};
-          crypto::public_key active_pub{};
+    //! Scanned blocks waiting for `db::storage::update`
+    struct commit_job
+    {
+      db::block_id chain_start;             //!< Height of `blockchain.front()`
+      db::block_id height;                  //!< Scan height after commit
+      std::vector<crypto::hash> blockchain;
+      std::vector<db::pow_sync> new_pow;
+      std::vector<lws::account> users;      //!< From `lws::account::split_update`
+      std::size_t blocks;
+      db::block_difficulty::unsigned_int diff;
+      bool log_pow;
+      std::vector<db::scan_index_block> scan_index; //!< Empty unless blocks are missing from index
+      commit_group::batch scanning;                 //!< Released when queued in `commit_group`
+    };
 
-          // inspect the additional and traditional keys
-          for (std::size_t attempt = 0; attempt < 2; ++attempt)
+    /*!
+      Runs `commit_group::update`, webhooks, and scan publishing for one scan
+      thread on a separate thread, so the commit of a batch overlaps the
+      scanning of the next batch. The scan thread blocks in `push` when
+      `commit_queue_max` jobs are already waiting.
+
+      After a failed commit (reorg, account changes, or an exception) the
+      remaining jobs are dropped, and `push`/`flush` return false until
+      `reset()` so the scan thread can reload its state. */
+    class commit_stage
+    {
+      static constexpr const std::size_t commit_queue_max = 2;
+
+      boost::mutex sync_;
+      boost::condition_variable ready_;
+      boost::condition_variable done_;
+      std::deque<commit_job> jobs_;
+      bool busy_;
+      bool stop_;
+      bool failed_;
+      commit_group& writer_;
+      rpc::client client_;
+      const scanner_options opts_;
+      boost::thread thread_;
+
+      bool commit(commit_job& job)
+      {
+        auto updated = writer_.update(
+          db::storage::update_request{
+            job.chain_start,
+            epee::to_span(job.blockchain),
+            epee::to_span(job.users),
+            epee::to_span(job.new_pow),
+            epee::to_span(job.scan_index)
+          },
+          this,
+          std::move(job.scanning)
+        );
+        if (!updated)
+        {
+          if (updated == lws::error::blockchain_reorg)
           {
-            if (attempt == 0)
-            {
-              active_derived = derived;
-              active_pub = key.pub_key;
-            }
-            else if (!additional_derivations.empty())
-            {
-              active_derived = additional_derivations.at(index);
-              active_pub = additional_tx_pub_keys.data.at(index);
-            }
-            else
-              break; // inspection loop
+            MINFO("Blockchain reorg detected, resetting state");
+            return false;
+          }
+          MONERO_THROW(updated.error(), "Failed to update accounts on disk");
+        }
 
-            crypto::public_key derived_pub;
-            if (!crypto::wallet::derive_subaddress_public_key(out_pub_key, active_derived, index, derived_pub))
-              continue; // to next available active_derived
+        if (job.log_pow && !job.blockchain.empty())
+        {
+          MINFO("On chain with hash " << job.blockchain.back() << " and difficulty " << job.diff << " at height " << std::uint64_t(job.height));
+        }
 
-            if (user.spend_public() != derived_pub)
-            {
-              if (!reader.reader)
-                continue; // to next available active_derived
+        MINFO("Processed " << job.blocks << " block(s) against " << job.users.size() << " account(s)");
+        send_payment_hook(client_, epee::to_span(updated->confirm_pubs), opts_.webhook_verify);
+        send_spend_hook(client_, epee::to_span(updated->spend_pubs), opts_.webhook_verify);
+        if (updated->accounts_updated != job.users.size())
+        {
+          MWARNING("Only updated " << updated->accounts_updated << " account(s) out of " << job.users.size() << ", resetting");
+          return false;
+        }
 
-              const expect<db::address_index> match =
-                reader.reader->find_subaddress(user.id(), derived_pub, reader.cur);
-              if (!match)
-              {
-                if (match != lmdb::error(MDB_NOTFOUND))
-                  MERROR("Failure when doing subaddress search: " << match.error().message());
-                continue; // to next available active_derived
-              }
-              found_pub = true;
-              account_index = *match;
-              break; // additional_derivations loop
-            }
-            else
-            {
-              found_pub = true;
-              break; // additional_derivations loop
-            }
-          }
+        for (account& user : job.users)
+          user.updated(job.height);
 
-          if (!found_pub)
-            continue; // to next output
+        // Publish when all scan threads have past this block
+        if (!job.blockchain.empty() && client_.has_publish())
+          rpc::publish_scanned(client_, job.blockchain.back(), epee::to_span(job.users));
+        return true;
+      }
 
-          if (!prefix_hash)
+      void run() noexcept
+      {
+        for (;;)
+        {
+          commit_job job{};
           {
-            prefix_hash.emplace();
-            cryptonote::get_transaction_prefix_hash(tx, *prefix_hash);
+            boost::unique_lock<boost::mutex> lock{sync_};
+            while (jobs_.empty() && !stop_)
+              ready_.wait(lock);
+            if (jobs_.empty())
+              return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+            busy_ = true;
           }
+          done_.notify_all(); // queue has space
 
-          std::uint64_t amount = out.amount;
-          rct::key mask = rct::identity();
-          if (!amount && !(ext & db::coinbase_output) && 1 < tx.version)
+          bool committed = false;
+          try
           {
-            const bool bulletproof2 = (rct::RCTTypeBulletproof2 <= tx.rct_signatures.type);
-            const auto decrypted = lws::decode_amount(
-              tx.rct_signatures.outPk.at(index).mask, tx.rct_signatures.ecdhInfo.at(index), active_derived, index, bulletproof2
-            );
-            if (!decrypted)
-            {
-              MWARNING(user.address() << " failed to decrypt amount for tx " << tx_hash << ", skipping output");
-              continue; // to next output
-            }
-            amount = decrypted->first;
-            mask = decrypted->second;
-            ext = db::extra(ext | db::ringct_output);
+            committed = commit(job);
+          }
+          catch (std::exception const& e)
+          {
+            scanner::stop();
+            MERROR(e.what());
+          }
+          catch (...)
+          {
+            scanner::stop();
+            MERROR("Unknown exception");
           }
 
-          if (extra_nonce)
           {
-            if (!payment_id.first && cryptonote::get_encrypted_payment_id_from_tx_extra_nonce(extra_nonce->nonce, payment_id.second.short_))
+            const boost::lock_guard<boost::mutex> lock{sync_};
+            busy_ = false;
+            if (!committed)
             {
-              payment_id.first = sizeof(crypto::hash8);
-              lws::decrypt_payment_id(payment_id.second.short_, active_derived);
+              failed_ = true;
+              jobs_.clear();
             }
           }
-          const bool added = output_action(
-            user,
-            db::output{
-              db::transaction_link{height, tx_hash},
-              db::output::spend_meta_{
-                db::output_id{tx.version < 2 ? out.amount : 0, out_ids.at(index)},
-                amount,
-                mixin,
-                boost::numeric_cast<std::uint32_t>(index),
-                active_pub
-              },
-              timestamp,
-              tx.unlock_time,
-              *prefix_hash,
-              out_pub_key,
-              mask,
-              {0, 0, 0, 0, 0, 0, 0}, // reserved bytes
-              db::pack(ext, payment_id.first),
-              payment_id.second,
-              cryptonote::get_tx_fee(tx),
-              account_index
-            }
-          );
+          done_.notify_all();
+        }
+      }
 
-          if (!added)
-            MWARNING("Output not added, duplicate public key encountered");
-        } // for all tx outs
-      } // for all users
-    }
+    public:
+      explicit commit_stage(commit_group& writer, rpc::client client, const scanner_options& opts, const boost::thread::attributes& attrs)
+        : sync_(),
+          ready_(),
+          done_(),
+          jobs_(),
+          busy_(false),
+          stop_(false),
+          failed_(false),
+          writer_(writer),
+          client_(std::move(client)),
+          opts_(opts),
+          thread_(attrs, [this] () { run(); })
+      {}
 
-    void scan_transaction(
-      epee::span<lws::account> users,
-      const db::block_id height,
-      const std::uint64_t timestamp,
-      crypto::hash const& tx_hash,
-      cryptonote::transaction const& tx,
-      std::vector<std::uint64_t> const& out_ids,
-      subaddress_reader& reader)
-    {
-      scan_transaction_base(users, height, timestamp, tx_hash, tx, out_ids, reader, add_spend{}, add_output{});
-    }
+      commit_stage(const commit_stage&) = delete;
+      commit_stage& operator=(const commit_stage&) = delete;
 
-    void scan_transactions(std::string&& txpool_msg, epee::span<lws::account> users, db::storage const& disk, rpc::client& client, const options& opts)
-    {
-      // uint64::max is for txpool
-      static const std::vector<std::uint64_t> fake_outs(
-        256, std::numeric_limits<std::uint64_t>::max()
-      );
+      //! Commits all queued jobs, then joins the thread.
+      ~commit_stage() noexcept
+      {
+        {
+          const boost::lock_guard<boost::mutex> lock{sync_};
+          stop_ = true;
+        }
+        ready_.notify_all();
+        thread_.join();
+      }
 
-      const auto parsed = rpc::full_txpool_pub::from_json(std::move(txpool_msg));
-      if (!parsed)
+      //! Queue `job`, waiting for space. \return False if a commit failed.
+      bool push(commit_job job)
       {
-        MERROR("Failed parsing txpool pub: " << parsed.error().message());
-        return;
+        {
+          boost::unique_lock<boost::mutex> lock{sync_};
+          while (!failed_ && commit_queue_max <= jobs_.size())
+            done_.wait(lock);
+          if (failed_)
+            return false;
+          jobs_.push_back(std::move(job));
+        }
+        ready_.notify_all();
+        return true;
       }
 
-      const auto time =
-        boost::numeric_cast<std::uint64_t>(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()));
+      //! Wait for all queued jobs to commit. \return False if a commit failed.
+      bool flush()
+      {
+        boost::unique_lock<boost::mutex> lock{sync_};
+        while (!failed_ && (busy_ || !jobs_.empty()))
+          done_.wait(lock);
+        return !failed_;
+      }
 
-      subaddress_reader reader{disk, opts.enable_subaddresses};
-      send_webhook sender{disk, client, opts.webhook_verify};
-      for (const auto& tx : parsed->txes)
-        scan_transaction_base(users, db::block_id::txpool, time, crypto::hash{}, tx, fake_outs, reader, null_spend{}, sender);
-    }
+      //! Drop queued jobs and clear a failed commit, after the current job.
+      void reset()
+      {
+        boost::unique_lock<boost::mutex> lock{sync_};
+        while (busy_)
+          done_.wait(lock);
+        jobs_.clear();
+        failed_ = false;
+      }
+    };
 
-    void update_rates(rpc::context& ctx)
+    lws::account prep_account(db::storage_reader& reader, const lws::db::account& user)
     {
-      const expect<boost::optional<lws::rates>> new_rates = ctx.retrieve_rates();
-      if (!new_rates)
-        MERROR("Failed to retrieve exchange rates: " << new_rates.error().message());
-      else if (*new_rates)
-        MINFO("Updated exchange rates: " << *(*new_rates));
+      std::vector<std::pair<db::output_id, db::address_index>> receives{};
+      std::vector<crypto::public_key> pubs{};
+
+      // compact table, avoids reading every full `db::output`
+      const std::vector<db::spendable_output> receive_list =
+        MONERO_UNWRAP(reader.get_spendables(user.id));
+
+      receives.reserve(receive_list.size());
+      pubs.reserve(receive_list.size());
+
+      for (const db::spendable_output& output : receive_list)
+      {
+        receives.emplace_back(output.id, output.recipient);
+        pubs.push_back(output.pub);
+      }
+
+      return lws::account{user, std::move(receives), std::move(pubs)};
     }
 
     void scan_loop(thread_sync& self, std::shared_ptr<thread_data> data, const bool untrusted_daemon, const bool leader_thread) noexcept
@@ -628,107 +2603,221 @@ namespace lws
         rpc::client client{std::move(data->client)};
         db::storage disk{std::move(data->disk)};
         std::vector<lws::account> users{std::move(data->users)};
-        const options opts = std::move(data->opts);
+        const scanner_options opts = std::move(data->opts);
+        bool tip = data->tip;
 
         assert(!users.empty());
         assert(std::is_sorted(users.begin(), users.end(), by_height{}));
 
-        data.reset();
-
         struct stop_
         {
           thread_sync& self;
+          bool detached; //!< No accounts left (handed off or removed), other threads keep running
           ~stop_() noexcept
           {
+            --self.scan_threads;
+            if (detached)
+              return;
             self.update = true;
             self.user_poll.notify_one();
           }
-        } stop{self};
+        } stop{self, false};
 
-        // RPC server assumes that `start_height == 0` means use
-        // block ids. This technically skips genesis block.
-        cryptonote::rpc::GetBlocksFast::Request req{};
-        req.start_height = std::uint64_t(users.begin()->scan_height());
-        req.start_height = std::max(std::uint64_t(1), req.start_height);
-        req.prune = !untrusted_daemon;
+        // destroyed first; queued commits finish before `stop` notifies
+        boost::thread::attributes attrs;
+        attrs.set_stack_size(THREAD_STACK_SIZE);
+        commit_stage committer{self.writer, std::move(data->commit_client), opts, attrs};
 
-        epee::byte_slice block_request = rpc::client::make_message("get_blocks_fast", req);
-        if (!send(client, block_request.clone()))
-          return;
+        data.reset();
+
+        std::uint64_t start_height = std::uint64_t(users.begin()->scan_height());
+        self.blocks.request(start_height);
+
+        spendable_index spendables{};
+        spendables.add(epee::to_span(users), 0);
+
+        // accounts deactivated after this thread started
+        std::size_t removed_seen = 0;
+
+        txpool_cache txpool{};
+
+        // subaddress keys are not sent with accounts, load on first batch
+        std::uint64_t subaddress_version = 0;
+        bool subaddress_refresh = opts.enable_subaddresses;
 
         std::vector<crypto::hash> blockchain{};
         std::vector<db::pow_sync> new_pow{};
-        db::pow_window pow_window{};
+        std::vector<scan_tx> batch{};
+        difficulty_window pow_window{};
+
+        /* With `untrusted_daemon`, `pow_window` and the recent block hashes
+          (for RandomX seeds) carry over to the next batch, so the queued
+          commits are only waited on when both must be re-read from the DB. */
+        boost::optional<db::block_id> pow_height; //!< Last block in `pow_window`, if valid
+        std::vector<crypto::hash> pow_hashes{};   //!< Blocks from `pow_hashes_start`, older ones are in DB
+        db::block_id pow_hashes_start = db::block_id(0);
 
         const db::block_info last_checkpoint = db::storage::get_last_checkpoint();
-        const db::block_id last_pow = MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_last_pow_block()).id;
-        while (!self.update && scanner::is_running())
+        db::block_id last_pow = MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_last_pow_block()).id;
+
+        // `self.reorg.synced()` when the current batch started
+        std::uint64_t reorgs_seen = self.reorg.synced();
+
+        /* A failed commit is a chain reorg, or accounts rolled back by another
+          thread that found the reorg first. Sync the chain (skipped if another
+          thread already did), and reload only the accounts of this thread from
+          the DB, which has rolled back their outputs and spends past the fork.
+          Other scan threads and the fetch thread keep running.
+          \return False if the thread must exit. */
+        const auto recover = [&] () -> bool
         {
-          blockchain.clear();
-          new_pow.clear();
+          if (!scanner::is_running())
+            return false;
+          committer.reset();
+          pow_height = boost::none;
 
-          auto resp = client.get_message(block_rpc_timeout);
-          if (!resp)
+          const expect<void> synced = self.reorg.sync(disk.clone(), untrusted_daemon, reorgs_seen);
+          if (!synced)
           {
-            const bool timeout = resp.matches(std::errc::timed_out);
-            if (timeout)
-              MWARNING("Block retrieval timeout, resetting scanner");
-            if (timeout || resp.matches(std::errc::interrupted))
-              return;
-            MONERO_THROW(resp.error(), "Failed to retrieve blocks from daemon");
+            MERROR("Failed to sync chain after reorg: " << synced.error().message());
+            return false;
           }
 
-          auto fetched = rpc::parse_json_response<rpc::get_blocks_fast>(std::move(*resp));
-          if (!fetched)
+          std::vector<lws::account> reloaded{};
           {
-            MERROR("Failed to retrieve next blocks: " << fetched.error().message() << ". Resetting state and trying again");
-            return;
+            auto reader = MONERO_UNWRAP(disk.start_read());
+            for (const lws::account& user : users)
+            {
+              const expect<db::account> current = reader.get_account(db::account_status::active, user.id());
+              if (current)
+                reloaded.push_back(prep_account(reader, *current));
+              // else deactivated, removed from `active` by `check_loop`
+            }
+            last_pow = MONERO_UNWRAP(reader.get_last_pow_block()).id;
           }
+          if (reloaded.empty())
+            return false;
 
-          if (fetched->blocks.empty())
-            throw std::runtime_error{"Daemon unexpectedly returned zero blocks"};
+          std::sort(reloaded.begin(), reloaded.end(), by_height{});
+          users = std::move(reloaded);
+          spendables = spendable_index{};
+          spendables.add(epee::to_span(users), 0);
+          subaddress_refresh = opts.enable_subaddresses;
+          txpool.accounts_changed();
+
+          start_height = std::uint64_t(users.front().scan_height());
+          self.blocks.drop_from(start_height);
+          self.blocks.request(start_height);
+          MINFO("Reloaded " << users.size() << " account(s) at height " << start_height << " after failed commit");
+          return true;
+        };
 
-          if (fetched->start_height != req.start_height)
-          {
-            MWARNING("Daemon sent wrong blocks, resetting state");
+        while (!self.update && scanner::is_running())
+        {
+          blockchain.clear();
+          new_pow.clear();
+          batch.clear();
+          reorgs_seen = self.reorg.synced();
+
+          // response is shared with other scan threads, do not modify
+          const block_cache::response chunk = self.blocks.get(start_height);
+          if (!chunk)
             return;
+          const rpc::get_blocks_fast::response& fetched = *chunk;
+
+          if (self.drop_removed(users, removed_seen))
+          {
+            // positions in `users` changed
+            spendables = spendable_index{};
+            spendables.add(epee::to_span(users), 0);
+            txpool.accounts_changed();
           }
 
           {
-            expect<std::vector<lws::account>> new_accounts = client.pull_accounts();
-            if (!new_accounts)
-            {
-              MERROR("Failed to pull new accounts: " << new_accounts.error().message());
-              return; // get all active accounts the easy way
-            }
-            if (!new_accounts->empty())
+            std::vector<lws::account> new_accounts{};
+            self.take_new(new_accounts, tip);
+            self.drop_removed(new_accounts); // deactivated while queued
+            if (!new_accounts.empty())
             {
-              MINFO("Received " << new_accounts->size() << " new account(s) for scanning");
-              std::sort(new_accounts->begin(), new_accounts->end(), by_height{});
-              const db::block_id oldest = new_accounts->front().scan_height();
+              MINFO("Received " << new_accounts.size() << " new account(s) for scanning");
+              txpool.accounts_changed();
+              subaddress_refresh = opts.enable_subaddresses;
+              std::sort(new_accounts.begin(), new_accounts.end(), by_height{});
+              const db::block_id oldest = new_accounts.front().scan_height();
+              const std::size_t count = new_accounts.size();
               users.insert(
                 users.end(),
-                std::make_move_iterator(new_accounts->begin()),
-                std::make_move_iterator(new_accounts->end())
+                std::make_move_iterator(new_accounts.begin()),
+                std::make_move_iterator(new_accounts.end())
               );
-              if (std::uint64_t(oldest) < fetched->start_height)
+
+              // commits start at the scan height of `users.front()`
+              std::inplace_merge(users.begin(), users.end() - count, users.end(), by_height{});
+              spendables = spendable_index{};
+              spendables.add(epee::to_span(users), 0);
+
+              if (std::uint64_t(oldest) < fetched.start_height)
               {
-                req.start_height = std::uint64_t(oldest);
-                block_request = rpc::client::make_message("get_blocks_fast", req);
-                if (!send(client, block_request.clone()))
-                  return;
+                start_height = std::uint64_t(oldest);
+                self.blocks.request(start_height);
                 continue; // to next get_blocks_fast read
               }
               // else, the oldest new account is within the newly fetched range
             }
           }
 
+          if (users.empty())
+          {
+            if (self.leave(tip))
+            {
+              MINFO("Every account on scan thread was deactivated, stopping thread");
+              stop.detached = true;
+              return;
+            }
+            continue; // last of its kind, take accounts waiting for it
+          }
+
+          if (opts.enable_subaddresses && subaddress_version != disk.subaddress_version())
+            subaddress_refresh = true;
+          if (subaddress_refresh)
+          {
+            subaddress_version = disk.subaddress_version();
+            refresh_subaddresses(epee::to_mut_span(users), disk);
+            subaddress_refresh = false;
+          }
+
           // prep for next blocks retrieval
-          req.start_height = fetched->start_height + fetched->blocks.size() - 1;
-          block_request = rpc::client::make_message("get_blocks_fast", req);
+          start_height = fetched.start_height + fetched.blocks.size() - 1;
 
-          if (fetched->blocks.size() <= 1)
+          if (fetched.blocks.size() <= 1)
           {
+            // new block checks read the scan height from the DB
+            if (!committer.flush())
+            {
+              if (!recover())
+                return;
+              continue; // to next get_blocks_fast read
+            }
+
+            if (!tip)
+            {
+              if (!self.leave(false))
+              {
+                self.blocks.request(start_height);
+                continue; // last catch-up thread, take accounts waiting for it
+              }
+
+              // accounts caught up, stop delaying (or being delayed by) other catch-up accounts
+              if (self.hand_off(users))
+              {
+                MINFO("Catch-up thread reached chain top, moved accounts to tip thread(s)");
+                stop.detached = true;
+                return;
+              }
+              tip = true;
+              MINFO("Catch-up thread reached chain top, now a tip thread");
+            }
+
             // synced to top of chain, wait for next blocks
             for (bool wait_for_block = true; wait_for_block; )
             {
@@ -749,7 +2838,7 @@ namespace lws
               {
                 if (message->first != rpc::client::topic::txpool)
                   break; // inner for loop
-                scan_transactions(std::move(message->second), epee::to_mut_span(users), disk, client, opts);
+                scan_transactions(std::move(message->second), epee::to_mut_span(users), spendables, txpool, disk, client, opts);
               }
 
               for ( ; message != new_pubs->end(); ++message)
@@ -760,47 +2849,86 @@ namespace lws
             } // wait for block
 
             // request next chunk of blocks
-            if (!send(client, block_request.clone()))
-              return;
+            self.blocks.request(start_height);
             continue; // to next get_blocks_fast read
           } // if only one block was fetched
 
           // request next chunk of blocks
-          if (!send(client, block_request.clone()))
-            return;
+          self.blocks.request(start_height);
 
-          if (fetched->blocks.size() != fetched->output_indices.size())
+          if (fetched.blocks.size() != fetched.output_indices.size())
             throw std::runtime_error{"Bad daemon response - need same number of blocks and indices"};
 
-          blockchain.push_back(cryptonote::get_block_hash(fetched->blocks.front().block));
+          blockchain.push_back(cryptonote::get_block_hash(fetched.blocks.front().block));
           if (untrusted_daemon)
-            new_pow.push_back(db::pow_sync{fetched->blocks.front().block.timestamp});
+            new_pow.push_back(db::pow_sync{fetched.blocks.front().block.timestamp});
 
-          auto blocks = epee::to_mut_span(fetched->blocks);
-          auto indices = epee::to_span(fetched->output_indices);
+          auto blocks = epee::to_span(fetched.blocks);
+          auto indices = epee::to_span(fetched.output_indices);
 
-          if (fetched->start_height != 1)
+          std::uint64_t height = fetched.start_height;
+          if (height != 1)
           {
             // skip overlap block
             blocks.remove_prefix(1);
             indices.remove_prefix(1);
           }
           else
-            fetched->start_height = 0;
+            height = 0;
+
+          if (!txpool.empty())
+          {
+            for (const auto& block : blocks)
+            {
+              for (const auto& tx : block.transactions)
+                txpool.erase(tx);
+            }
+          }
 
           if (untrusted_daemon)
           {
-            pow_window = MONERO_UNWRAP(
-              MONERO_UNWRAP(disk.start_read()).get_pow_window(db::block_id(fetched->start_height))
-            );
+            const bool carry_over =
+              pow_height == db::block_id(height) &&
+              !pow_hashes.empty() &&
+              pow_hashes.back() == blockchain.front() &&
+              pow_hashes.size() < pow_hashes_max;
+            pow_height = boost::none; // set again once this batch is verified
+
+            if (!carry_over)
+            {
+              // PoW window and older RandomX seeds are read from the DB
+              if (!committer.flush())
+              {
+                if (!recover())
+                  return;
+                continue; // to next get_blocks_fast read
+              }
+
+              pow_window = difficulty_window{
+                MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_pow_window(db::block_id(height)))
+              };
+              pow_hashes.assign(1, blockchain.front());
+              pow_hashes_start = db::block_id(height);
+            }
+
+            // blocks stored by any scan thread were verified by that thread
+            last_pow = std::max(last_pow, MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_last_pow_block()).id);
+            self.pow.stored(last_pow);
           }
 
-          subaddress_reader reader{disk, opts.enable_subaddresses};
+          // other threads committing now can wait for this batch
+          commit_group::batch scanning{self.writer, std::addressof(committer)};
+
+          // another scan thread already stored these blocks, or they came from the index
+          const bool add_scan_index =
+            opts.scan_index && needs_scan_index(disk, db::block_id(height + 1), db::block_id(height + blocks.size()));
+          std::vector<db::scan_index_block> scan_index{};
+
           db::block_difficulty::unsigned_int diff{};
-          const db::block_id initial_height = db::block_id(fetched->start_height);
+          pow_verifier pow_checks{std::addressof(self.pow)};
           for (auto block_data : boost::combine(blocks, indices))
           {
-            ++(fetched->start_height);
+            ++height;
 
             cryptonote::block const& block = boost::get<0>(block_data).block;
             auto const& txes = boost::get<0>(block_data).transactions;
@@ -816,43 +2944,37 @@ namespace lws
             if (!cryptonote::get_transaction_hash(block.miner_tx, miner_tx_hash))
               throw std::runtime_error{"Failed to calculate miner tx hash"};
 
-            scan_transaction(
-              epee::to_mut_span(users),
-              db::block_id(fetched->start_height),
-              block.timestamp,
-              miner_tx_hash,
-              block.miner_tx,
-              *(indices.begin()),
-              reader
-            );
+            {
+              scan_tx data{db::block_id(height), block.timestamp, miner_tx_hash, std::addressof(block.miner_tx), std::addressof(*indices.begin())};
+              if (prepare_tx(data, opts.enable_subaddresses))
+                batch.push_back(std::move(data));
+            }
 
             if (untrusted_daemon)
             {
               if (block.prev_id != blockchain.back())
                 MONERO_THROW(error::bad_blockchain, "A blocks prev_id does not match");
 
-              update_window(pow_window.pow_timestamps);
-              update_window(pow_window.cumulative_diffs);
-
-              while (BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW < pow_window.median_timestamps.size())
-                pow_window.median_timestamps.erase(pow_window.median_timestamps.begin());
-
               // longhash takes a while, check is_running
               if (!scanner::is_running())
                 return; 
 
-              diff = cryptonote::next_difficulty(pow_window.pow_timestamps, pow_window.cumulative_diffs, get_target_time(db::block_id(fetched->start_height)));
+              diff = pow_window.next_difficulty(get_target_time(db::block_id(height)));
 
               // skip POW hashing if done previously
-              if (last_pow < db::block_id(fetched->start_height))
+              if (last_pow < db::block_id(height))
               {
-                if (!verify_timestamp(block.timestamp, pow_window.median_timestamps))
+                if (!pow_window.verify_timestamp(block.timestamp))
                   MONERO_THROW(error::bad_blockchain, "Block failed timestamp check - possible chain forgery");
 
-                const crypto::hash pow =
-                  get_block_longhash(get_block_hashing_blob(block), db::block_id(fetched->start_height), block.major_version, disk, initial_height, epee::to_span(blockchain));
-                if (!cryptonote::check_hash(pow, diff))
-                  MONERO_THROW(error::bad_blockchain, "Block had too low difficulty");
+                pow_checks.push(pow_check{
+                  get_block_hashing_blob(block),
+                  cryptonote::get_block_hash(block),
+                  get_seed_hash(db::block_id(height), block.major_version, disk, pow_hashes_start, epee::to_span(pow_hashes)),
+                  diff,
+                  db::block_id(height),
+                  block.major_version
+                });
               }
             }
 
@@ -868,66 +2990,70 @@ namespace lws
                   MONERO_THROW(error::bad_blockchain, "Hash of transaction does not match hash in block");
               }
 
-              scan_transaction(
-                epee::to_mut_span(users),
-                db::block_id(fetched->start_height),
+              scan_tx data{
+                db::block_id(height),
                 block.timestamp,
                 boost::get<0>(tx_data),
-                boost::get<1>(tx_data),
-                boost::get<2>(tx_data),
-                reader
-              );
+                std::addressof(boost::get<1>(tx_data)),
+                std::addressof(boost::get<2>(tx_data))
+              };
+              if (prepare_tx(data, opts.enable_subaddresses))
+                batch.push_back(std::move(data));
             }
 
             if (untrusted_daemon)
             {
-              const auto last_difficulty =
-                pow_window.cumulative_diffs.empty() ?
-                  db::block_difficulty::unsigned_int(0) : pow_window.cumulative_diffs.back();
-
-              pow_window.pow_timestamps.push_back(block.timestamp);
-              pow_window.median_timestamps.push_back(block.timestamp);
-              pow_window.cumulative_diffs.push_back(diff + last_difficulty);
+              pow_window.push(block.timestamp, diff);
               new_pow.push_back(db::pow_sync{block.timestamp});
-              new_pow.back().cumulative_diff.set_difficulty(pow_window.cumulative_diffs.back());
+              new_pow.back().cumulative_diff.set_difficulty(pow_window.cumulative_difficulty());
             }
+
+            if (add_scan_index)
+              scan_index.push_back(make_scan_index(db::block_id(height), boost::get<0>(block_data), boost::get<1>(block_data)));
             blockchain.push_back(cryptonote::get_block_hash(block));
+            if (untrusted_daemon)
+              pow_hashes.push_back(blockchain.back());
           } // for each block
 
-          reader.reader = std::error_code{common_error::kInvalidArgument}; // cleanup reader before next write
-          auto updated = disk.update(
-            users.front().scan_height(), epee::to_span(blockchain), epee::to_span(users), epee::to_span(new_pow)
-          );
-          if (!updated)
-          {
-            if (updated == lws::error::blockchain_reorg)
-            {
-              MINFO("Blockchain reorg detected, resetting state");
-              return;
-            }
-            MONERO_THROW(updated.error(), "Failed to update accounts on disk");
-          }
+          // hashing overlaps with scanning
+          pow_checks.start(opts.pow_fast_mode);
 
-          if (untrusted_daemon && leader_thread && fetched->start_height % 4 == 0 && last_pow < db::block_id(fetched->start_height))
-          {
-            MINFO("On chain with hash " << blockchain.back() << " and difficulty " << diff << " at height " << fetched->start_height);
-          }
+          if (opts.work_pool)
+            scan_batch_pooled(epee::to_mut_span(users), spendables, epee::to_span(batch));
+          else
+            scan_batch(epee::to_mut_span(users), spendables, epee::to_span(batch));
 
-          MINFO("Processed " << blocks.size() << " block(s) against " << users.size() << " account(s)");
-          send_payment_hook(client, epee::to_span(updated->confirm_pubs), opts.webhook_verify);
-          send_spend_hook(client, epee::to_span(updated->spend_pubs), opts.webhook_verify);
-          if (updated->accounts_updated != users.size())
+          if (!pow_checks.empty())
           {
-            MWARNING("Only updated " << updated->accounts_updated << " account(s) out of " << users.size() << ", resetting");
-            return;
+            const boost::optional<db::block_id> failed = pow_checks.wait();
+            if (failed)
+              MONERO_THROW(error::bad_blockchain, "Block " + std::to_string(std::uint64_t(*failed)) + " had too low difficulty");
           }
-
+          if (untrusted_daemon)
+            pow_height = db::block_id(height);
+
+          commit_job job{
+            users.front().scan_height(),
+            db::block_id(height),
+            std::move(blockchain),
+            std::move(new_pow),
+            {},
+            blocks.size(),
+            diff,
+            untrusted_daemon && leader_thread && height % 4 == 0 && last_pow < db::block_id(height),
+            std::move(scan_index),
+            std::move(scanning)
+          };
+          job.users.reserve(users.size());
           for (account& user : users)
-            user.updated(db::block_id(fetched->start_height));
+            job.users.push_back(user.split_update(db::block_id(height)));
 
-          // Publish when all scan threads have past this block
-          if (!blockchain.empty() && client.has_publish())
-            rpc::publish_scanned(client, blockchain.back(), epee::to_span(users));
+          if (!committer.push(std::move(job)))
+          {
+            if (!recover())
+              return;
+            continue; // to next get_blocks_fast read
+          }
         }
       }
       catch (std::exception const& e)
@@ -942,37 +3068,16 @@ namespace lws
       }
     }
 
-    lws::account prep_account(db::storage_reader& reader, const lws::db::account& user)
-    {
-      std::vector<std::pair<db::output_id, db::address_index>> receives{};
-      std::vector<crypto::public_key> pubs{};
-      auto receive_list = MONERO_UNWRAP(reader.get_outputs(user.id));
-
-      const std::size_t elems = receive_list.count();
-      receives.reserve(elems);
-      pubs.reserve(elems);
-
-      for (auto output = receive_list.make_iterator(); !output.is_end(); ++output)
-      {
-        auto id = output.get_value<MONERO_FIELD(db::output, spend_meta.id)>();
-        auto subaddr = output.get_value<MONERO_FIELD(db::output, recipient)>();
-        receives.emplace_back(std::move(id), std::move(subaddr));
-        pubs.emplace_back(output.get_value<MONERO_FIELD(db::output, pub)>());
-      }
-
-      return lws::account{user, std::move(receives), std::move(pubs)};
-    }
-
     /*!
       Launches `thread_count` threads to run `scan_loop`, and then polls for
       active account changes in background
     */
-    void check_loop(db::storage disk, rpc::context& ctx, std::size_t thread_count, std::vector<lws::account> users, std::vector<db::account_id> active, const options opts)
+    void check_loop(db::storage disk, rpc::context& ctx, std::size_t thread_count, std::vector<lws::account> users, std::vector<db::account_id> active, const scanner_options opts)
     {
       assert(0 < thread_count);
       assert(0 < users.size());
 
-      thread_sync self{};
+      thread_sync self{disk.clone(), thread_count, MONERO_UNWRAP(ctx.connect())};
       std::vector<boost::thread> threads{};
 
       struct join_
@@ -984,6 +3089,7 @@ namespace lws
         ~join_() noexcept
         {
           self.update = true;
+          self.blocks.close();
           ctx.raise_abort_scan();
           for (auto& thread : threads)
             thread.join();
@@ -991,67 +3097,127 @@ namespace lws
       } join{self, threads, ctx};
 
       /*
-        The algorithm here is extremely basic. Users are divided evenly amongst
-        the configurable thread count, and grouped by scan height. If an old
-        account appears, some accounts (grouped on that thread) will be delayed
-        in processing waiting for that account to catch up. Its not the greatest,
-        but this "will have to do" for the first cut.
-        Its not expected that many people will be running
-        "enterprise level" of nodes where accounts are constantly added.
-
-        Another "issue" is that each thread works independently instead of more
-        cooperatively for scanning. This requires a bit more synchronization, so
-        was left for later. Its likely worth doing to reduce the number of
-        transfers from the daemon, and the bottleneck on the writes into LMDB.
-
-        If the active user list changes, all threads are stopped/joined, and
-        everything is re-started.
+        Accounts within `tip_band` of the chain top are split evenly amongst
+        "tip" threads, and older accounts are split (grouped by scan height)
+        amongst "catch-up" threads. An old account only delays accounts at
+        similar heights, and never the accounts waiting on new blocks. When a
+        catch-up thread reaches the chain top, its accounts are handed to a
+        tip thread (or it becomes a tip thread if none exist) without a
+        restart.
+
+        New accounts are handed to tip threads the same way. New accounts
+        behind the tip band (or with no tip thread running) get a new
+        catch-up thread, or once `thread_count` tip and catch-up threads are
+        running are queued for an existing one, which rewinds to scan them.
+        Threads that stopped after handing off (or losing) their accounts
+        are joined on the next account poll.
+
+        Threads at the same height share block downloads via `block_cache`, so
+        each range is requested from the daemon and parsed once. Writes into
+        LMDB are still done independently by each thread, but on a separate
+        `commit_stage` thread so the next batch is scanned during the write.
+
+        With `scanner_options::work_pool`, each thread splits its batch into
+        tasks on the shared compute threadpool. A thread stuck behind an old
+        account then uses every idle core instead of one.
+
+        Deactivated accounts are handed to the running threads with
+        `remove_accounts`, and each thread drops them between batches with
+        `drop_removed`. New accounts are handed to the existing threads, or
+        to a new catch-up thread. All threads are stopped/joined, and
+        everything is re-started, only when a re-activated account appears.
       */
 
       boost::thread::attributes attrs;
       attrs.set_stack_size(THREAD_STACK_SIZE);
 
-      threads.reserve(thread_count);
+      threads.reserve(thread_count * 2);
       std::sort(users.begin(), users.end(), by_height{});
 
-      // enable the new bind point before registering pull accounts
-      lws::rpc::account_push pusher = MONERO_UNWRAP(ctx.bind_push());
-
-      MINFO("Starting scan loops on " << std::min(thread_count, users.size()) << " thread(s) with " << users.size() << " account(s)");
+      const auto in_tip_band = [] (const lws::account& user, const db::block_id chain_top)
+      {
+        return std::uint64_t(chain_top) <= std::uint64_t(user.scan_height()) + tip_band;
+      };
 
       bool leader_thread = true;
-      bool remaining_threads = true;
-      while (!users.empty() && --thread_count)
+      std::size_t fetch_threads = 0;
+      const auto start_thread = [&] (std::vector<lws::account> thread_users, const bool tip)
       {
-        const std::size_t per_thread = std::max(std::size_t(1), users.size() / (thread_count + 1));
-        const std::size_t count = std::min(per_thread, users.size());
-        std::vector<lws::account> thread_users{
-          std::make_move_iterator(users.end() - count), std::make_move_iterator(users.end())
-        };
-        users.erase(users.end() - count, users.end());
+        /* A fetch thread per running scan thread, so different ranges are not
+          serialized. Fetch threads share `self.blocks`, so those started for
+          scan threads that since stopped are re-used. */
+        ++self.scan_threads;
+        if (fetch_threads < std::min(thread_count, std::size_t(self.scan_threads)))
+        {
+          ++fetch_threads;
+          rpc::client client = MONERO_UNWRAP(ctx.connect());
+          MONERO_UNWRAP(client.watch_scan_signals());
+
+          auto data = std::make_shared<fetch_data>(fetch_data{std::move(client), disk.clone()});
+          threads.emplace_back(attrs, std::bind(&fetch_loop, std::ref(self.blocks), std::move(data), opts));
+        }
 
         rpc::client client = MONERO_UNWRAP(ctx.connect());
         MONERO_UNWRAP(client.watch_scan_signals());
-        MONERO_UNWRAP(client.enable_pull_accounts());
+        {
+          const boost::lock_guard<boost::mutex> lock{self.handoff_sync};
+          ++(tip ? self.tip_threads : self.catch_up_threads);
+        }
 
         auto data = std::make_shared<thread_data>(
-          std::move(client), disk.clone(), std::move(thread_users), opts
+          std::move(client), MONERO_UNWRAP(ctx.connect()), disk.clone(), std::move(thread_users), opts, tip
         );
         threads.emplace_back(attrs, std::bind(&scan_loop, std::ref(self), std::move(data), opts.untrusted_daemon, leader_thread));
         leader_thread = false;
-      }
+      };
 
-      if (!users.empty())
+      // split `group` (sorted by height) evenly over `count` threads
+      const auto start_group = [&start_thread] (std::vector<lws::account> group, std::size_t count, const bool tip)
       {
-        rpc::client client = MONERO_UNWRAP(ctx.connect());
-        MONERO_UNWRAP(client.watch_scan_signals());
-        MONERO_UNWRAP(client.enable_pull_accounts());
+        for ( ; !group.empty(); --count)
+        {
+          const std::size_t per_thread =
+            count <= 1 ? group.size() : std::max(std::size_t(1), group.size() / count);
+          std::vector<lws::account> thread_users{
+            std::make_move_iterator(group.end() - per_thread), std::make_move_iterator(group.end())
+          };
+          group.erase(group.end() - per_thread, group.end());
+          start_thread(std::move(thread_users), tip);
+        }
+      };
 
-        auto data = std::make_shared<thread_data>(
-          std::move(client), disk.clone(), std::move(users), opts
-        );
-        threads.emplace_back(attrs, std::bind(&scan_loop, std::ref(self), std::move(data), opts.untrusted_daemon, leader_thread));
-        remaining_threads = false;
+      {
+        const db::block_id chain_top = MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_last_block()).id;
+        const auto first_tip = std::find_if(users.begin(), users.end(), [&] (const lws::account& user)
+        {
+          return in_tip_band(user, chain_top);
+        });
+
+        std::vector<lws::account> catch_up{
+          std::make_move_iterator(users.begin()), std::make_move_iterator(first_tip)
+        };
+        users.erase(users.begin(), first_tip);
+
+        std::size_t tip_count = thread_count;
+        if (!catch_up.empty())
+        {
+          if (users.empty() || thread_count == 1)
+          {
+            // catch-up threads become tip threads at the chain top
+            catch_up.insert(catch_up.end(), std::make_move_iterator(users.begin()), std::make_move_iterator(users.end()));
+            users.clear();
+            tip_count = 0;
+          }
+          else
+          {
+            tip_count = std::max(std::size_t(1), thread_count * users.size() / (users.size() + catch_up.size()));
+            tip_count = std::min(thread_count - 1, tip_count);
+          }
+        }
+
+        MINFO("Starting scan loops with " << users.size() << " tip and " << catch_up.size() << " catch-up account(s)");
+        start_group(std::move(users), tip_count, true);
+        start_group(std::move(catch_up), thread_count - tip_count, false);
       }
 
       auto last_check = std::chrono::steady_clock::now();
@@ -1078,6 +3244,15 @@ namespace lws
           }
         }
 
+        // scan threads that returned after a handoff or removal
+        threads.erase(
+          std::remove_if(threads.begin(), threads.end(), [] (boost::thread& thread)
+          {
+            return thread.try_join_for(boost::chrono::milliseconds{0});
+          }),
+          threads.end()
+        );
+
         auto reader = disk.start_read(std::move(read_txn));
         if (!reader)
         {
@@ -1092,12 +3267,6 @@ namespace lws
         auto current_users = MONERO_UNWRAP(
           reader->get_accounts(db::account_status::active, std::move(accounts_cur))
         );
-        if (current_users.count() < active.size())
-        {
-          // cannot remove accounts via ZMQ (yet)
-          MINFO("Decrease in active user accounts detected, stopping scan threads...");
-          return;
-        }
         std::vector<db::account_id> active_copy = active;
         std::vector<lws::account> new_;
         for (auto user = current_users.make_iterator(); !user.is_end(); ++user)
@@ -1106,6 +3275,12 @@ namespace lws
           const auto loc = std::lower_bound(active_copy.begin(), active_copy.end(), user_id);
           if (loc == active_copy.end() || *loc != user_id)
           {
+            if (self.is_removed(user_id))
+            {
+              // a scan thread could still have the old copy
+              MINFO("Re-activated account detected, stopping scan threads...");
+              return;
+            }
             new_.emplace_back(prep_account(*reader, user.get_value<db::account>()));
             active.insert(
               std::lower_bound(active.begin(), active.end(), user_id), user_id
@@ -1117,26 +3292,51 @@ namespace lws
 
         if (!active_copy.empty())
         {
-          MINFO("Change in active user accounts detected, stopping scan threads...");
-          return;
+          // remaining ids were deactivated
+          for (const db::account_id id : active_copy)
+            active.erase(std::lower_bound(active.begin(), active.end(), id));
+          self.remove_accounts(epee::to_span(active_copy));
+          MINFO("Removing " << active_copy.size() << " deactivated account(s) from scan threads");
         }
         if (!new_.empty())
         {
-          if (remaining_threads)
+          const db::block_id chain_top = MONERO_UNWRAP(reader->get_last_block()).id;
+          std::sort(new_.begin(), new_.end(), by_height{});
+          const auto first_tip = std::find_if(new_.begin(), new_.end(), [&] (const lws::account& user)
           {
-            MINFO("Received new account(s), starting more thread(s)");
-            return;
+            return in_tip_band(user, chain_top);
+          });
+
+          std::vector<lws::account> catch_up{
+            std::make_move_iterator(new_.begin()), std::make_move_iterator(first_tip)
+          };
+          new_.erase(new_.begin(), first_tip);
+          if (!new_.empty())
+          {
+            const std::size_t count = new_.size();
+            if (self.give_tip_threads(new_))
+              MINFO("Handed " << count << " new account(s) to tip thread(s)");
+            else
+            {
+              catch_up.insert(catch_up.end(), std::make_move_iterator(new_.begin()), std::make_move_iterator(new_.end()));
+              new_.clear();
+            }
           }
 
-          const auto pushed = pusher.push(epee::to_span(new_), std::chrono::seconds{1});
-          if (!pushed)
+          if (!catch_up.empty())
           {
-            MERROR("Failed to push new account to workers: " << pushed.error().message());
-            return; // pull in new accounts by resetting state
+            // at most `thread_count` tip and catch-up threads
+            const std::size_t count = catch_up.size();
+            if (self.give_catch_up_threads(catch_up, thread_count))
+              MINFO("Handed " << count << " new account(s) to running scan thread(s)");
+            else
+            {
+              MINFO("Starting catch-up thread for " << count << " new account(s)");
+              start_thread(std::move(catch_up), false);
+            }
           }
-          else
-            MINFO("Pushed " << new_.size() << " new accounts to worker thread(s)");
         }
+
         read_txn = reader->finish_read();
         accounts_cur = current_users.give_cursor();
       } // while scanning
@@ -1263,8 +3463,9 @@ namespace lws
         // genesis block must be present as last entry
         req.block_ids.erase(req.block_ids.begin(), --(req.block_ids.end()));
 
-        auto pow_window =
-          MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_pow_window(db::block_id(resp->start_height)));
+        difficulty_window pow_window{
+          MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_pow_window(db::block_id(resp->start_height)))
+        };
 
         // overlap check performed in db::storage::pow_sync
         new_hashes.clear();
@@ -1276,6 +3477,7 @@ namespace lws
 
         // skip overlap block
         db::block_difficulty::unsigned_int diff = 0;
+        pow_verifier pow_checks{nullptr};
         for (std::size_t i = 1; i < resp->blocks.size(); ++i)
         {
           const auto& block = resp->blocks[i].block;
@@ -1290,49 +3492,45 @@ namespace lws
             return {lws::error::bad_blockchain};
 
           req.block_ids.push_front(hash);
-          update_window(pow_window.pow_timestamps);
-          update_window(pow_window.cumulative_diffs);
-
-          while (BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW < pow_window.median_timestamps.size())
-            pow_window.median_timestamps.erase(pow_window.median_timestamps.begin());
 
           // longhash takes a while, check is_running
           if (!scanner::is_running())
             return {error::signal_abort_process}; 
 
-          diff = cryptonote::next_difficulty(pow_window.pow_timestamps, pow_window.cumulative_diffs, get_target_time(height));
+          diff = pow_window.next_difficulty(get_target_time(height));
 
           // skip POW hashing when sync is within checkpoint
           // storage::sync_pow(...) currently verifies checkpoint hashes
           if (last_checkpoint.id < height)
           {
-            if (!verify_timestamp(block.timestamp, pow_window.median_timestamps))
+            if (!pow_window.verify_timestamp(block.timestamp))
             {
               MERROR("Block failed timestamp check - possible chain forgery");
               return {error::bad_blockchain};
             }
-            const crypto::hash pow =
-              get_block_longhash(get_block_hashing_blob(block), height, block.major_version, disk, db::block_id(resp->start_height), epee::to_span(new_hashes));
-
-            if (!cryptonote::check_hash(pow, diff))
-            {
-              MERROR("Block " << std::uint64_t(height) << "had too low difficulty");
-              return {error::bad_blockchain};
-            }
+            pow_checks.push(pow_check{
+              get_block_hashing_blob(block),
+              hash,
+              get_seed_hash(height, block.major_version, disk, db::block_id(resp->start_height), epee::to_span(new_hashes)),
+              diff,
+              height,
+              block.major_version
+            });
           }
 
-          const auto last_difficulty =
-            pow_window.cumulative_diffs.empty() ?
-              db::block_difficulty::unsigned_int(0) : pow_window.cumulative_diffs.back();
-
-          pow_window.pow_timestamps.push_back(block.timestamp);
-          pow_window.median_timestamps.push_back(block.timestamp);
-          pow_window.cumulative_diffs.push_back(diff + last_difficulty);
+          pow_window.push(block.timestamp, diff);
           new_hashes.push_back(hash);
           new_pow.push_back(db::pow_sync{block.timestamp});
-          new_pow.back().cumulative_diff.set_difficulty(pow_window.cumulative_diffs.back());
+          new_pow.back().cumulative_diff.set_difficulty(pow_window.cumulative_difficulty());
         } // for every tx in block
 
+        const boost::optional<db::block_id> failed = pow_checks.wait();
+        if (failed)
+        {
+          MERROR("Block " << std::uint64_t(*failed) << " had too low difficulty");
+          return {error::bad_blockchain};
+        }
+
         MONERO_CHECK(disk.sync_pow(db::block_id(resp->start_height), epee::to_span(new_hashes), epee::to_span(new_pow)));
         MINFO("Verified up to block " << (resp->start_height + new_hashes.size() - 1) << " with hash " << hash << " and difficulty " << diff);
 
@@ -1349,7 +3547,7 @@ namespace lws
     return sync_quick(std::move(disk), std::move(client));
   }
 
-  void scanner::run(db::storage disk, rpc::context ctx, std::size_t thread_count, const epee::net_utils::ssl_verification_t webhook_verify, const bool enable_subaddresses, const bool untrusted_daemon)
+  void scanner::run(db::storage disk, rpc::context ctx, std::size_t thread_count, const scanner_options& opts)
   {
     thread_count = std::max(std::size_t(1), thread_count);
 
@@ -1387,7 +3585,7 @@ namespace lws
         checked_wait(account_poll_interval - (std::chrono::steady_clock::now() - last));
       }
       else
-        check_loop(disk.clone(), ctx, thread_count, std::move(users), std::move(active), options{webhook_verify, enable_subaddresses, untrusted_daemon});
+        check_loop(disk.clone(), ctx, thread_count, std::move(users), std::move(active), opts);
 
       if (!scanner::is_running())
         return;
@@ -1395,7 +3593,7 @@ namespace lws
       if (!client)
         client = MONERO_UNWRAP(ctx.connect());
 
-      expect<rpc::client> synced = sync(disk.clone(), std::move(client), untrusted_daemon);
+      expect<rpc::client> synced = sync(disk.clone(), std::move(client), opts.untrusted_daemon);
       if (!synced)
       {
         if (!synced.matches(std::errc::timed_out))
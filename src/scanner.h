@@ -37,6 +37,17 @@
 
 namespace lws
 {
+  //! Configuration for `scanner::run`.
+  struct scanner_options
+  {
+    epee::net_utils::ssl_verification_t webhook_verify;
+    bool enable_subaddresses;
+    bool untrusted_daemon;
+    bool work_pool; //!< Scan each block batch with tasks on a shared threadpool
+    bool scan_index; //!< Store pruned blocks locally, and re-scan from them when possible
+    bool pow_fast_mode; //!< Set RandomX main seed, to use the full dataset when verifying PoW
+  };
+
   //! Scans all active `db::account`s. Detects if another process changes active list.
   class scanner
   {
@@ -49,7 +60,7 @@ namespace lws
     static expect<rpc::client> sync(db::storage disk, rpc::client client, const bool untrusted_daemon = false);
 
     //! Poll daemon until `stop()` is called, using `thread_count` threads.
-    static void run(db::storage disk, rpc::context ctx, std::size_t thread_count, epee::net_utils::ssl_verification_t webhook_verify, bool enable_subaddresses, bool untrusted_daemon = false);
+    static void run(db::storage disk, rpc::context ctx, std::size_t thread_count, const scanner_options& opts);
 
     //! \return True if `stop()` has never been called.
     static bool is_running() noexcept { return running; }
@@ -81,6 +81,14 @@ namespace
     const command_line::arg_descriptor<std::uint32_t> max_subaddresses;
     const command_line::arg_descriptor<bool> auto_accept_creation;
     const command_line::arg_descriptor<bool> untrusted_daemon;
+    const command_line::arg_descriptor<bool> scan_work_pool;
+    const command_line::arg_descriptor<bool> scan_index;
+    const command_line::arg_descriptor<bool> pow_fast_mode;
+    const command_line::arg_descriptor<std::string> db_sync;
+    const command_line::arg_descriptor<std::uint32_t> db_sync_interval;
+    const command_line::arg_descriptor<std::uint64_t> db_map_size;
+    const command_line::arg_descriptor<bool> db_write_map;
+    const command_line::arg_descriptor<bool> db_no_read_ahead;
 
     static std::string get_default_zmq()
     {
@@ -126,6 +134,14 @@ namespace
       , max_subaddresses{"max-subaddresses", "Maximum number of subaddresses per primary account (defaults to 0)", 0}
       , auto_accept_creation{"auto-accept-creation", "New account creation requests are automatically accepted", false}
       , untrusted_daemon{"untrusted-daemon", "Perform (expensive) chain-verification and PoW checks", false}
+      , scan_work_pool{"scan-work-pool", "Split each block batch into tasks across all CPU cores, instead of one thread per account group", false}
+      , scan_index{"scan-index", "Store pruned blocks in the database, so new accounts and rescans can be scanned without the daemon", false}
+      , pow_fast_mode{"untrusted-daemon-fast-pow", "Use the RandomX full dataset (over 2 GiB) for --untrusted-daemon PoW checks when available", false}
+      , db_sync{"db-sync", "[<full|meta|none>] LMDB disk sync on every commit, or only in background (faster, recent commits can be lost on OS crash)", "full"}
+      , db_sync_interval{"db-sync-interval", "Seconds between background LMDB syncs when --db-sync is not full", 5}
+      , db_map_size{"db-map-size", "Initial LMDB map size in MiB (0 for existing/default size)", 0}
+      , db_write_map{"db-write-map", "Use a writeable LMDB memory map (MDB_WRITEMAP)", false}
+      , db_no_read_ahead{"db-no-read-ahead", "Disable OS read-ahead on LMDB file (MDB_NORDAHEAD), for databases larger than RAM", false}
     {}
 
     void prepare(boost::program_options::options_description& description) const
@@ -159,12 +175,21 @@ namespace
       command_line::add_arg(description, max_subaddresses);
       command_line::add_arg(description, auto_accept_creation);
       command_line::add_arg(description, untrusted_daemon);
+      command_line::add_arg(description, scan_work_pool);
+      command_line::add_arg(description, scan_index);
+      command_line::add_arg(description, pow_fast_mode);
+      command_line::add_arg(description, db_sync);
+      command_line::add_arg(description, db_sync_interval);
+      command_line::add_arg(description, db_map_size);
+      command_line::add_arg(description, db_write_map);
+      command_line::add_arg(description, db_no_read_ahead);
     }
   };
 
   struct program
   {
     std::string db_path;
+    lws::db::storage_options db_opts;
     std::vector<std::string> rest_servers;
     std::vector<std::string> admin_rest_servers;
     lws::rest_server::configuration rest_config;
@@ -177,6 +202,9 @@ namespace
     std::size_t scan_threads;
     unsigned create_queue_max;
     bool untrusted_daemon;
+    bool scan_work_pool;
+    bool scan_index;
+    bool pow_fast_mode;
   };
 
   void print_help(std::ostream& out)
@@ -232,8 +260,22 @@ namespace
     else if (webhook_verify_raw != "none")
       MONERO_THROW(lws::error::configuration, "Invalid webhook ssl verification mode");
 
+    lws::db::storage_options db_opts{};
+    const auto db_sync_raw = command_line::get_arg(args, opts.db_sync);
+    if (db_sync_raw == "meta")
+      db_opts.sync = lws::db::storage_options::durability::no_meta_sync;
+    else if (db_sync_raw == "none")
+      db_opts.sync = lws::db::storage_options::durability::no_sync;
+    else if (db_sync_raw != "full")
+      MONERO_THROW(lws::error::configuration, "Invalid db sync mode");
+    db_opts.sync_interval = std::chrono::seconds{command_line::get_arg(args, opts.db_sync_interval)};
+    db_opts.map_size = command_line::get_arg(args, opts.db_map_size) * 1024 * 1024;
+    db_opts.write_map = command_line::get_arg(args, opts.db_write_map);
+    db_opts.no_read_ahead = command_line::get_arg(args, opts.db_no_read_ahead);
+
     program prog{
       command_line::get_arg(args, opts.db_path),
+      db_opts,
       command_line::get_arg(args, opts.rest_servers),
       command_line::get_arg(args, opts.admin_rest_servers),
       lws::rest_server::configuration{
@@ -263,7 +305,10 @@ namespace
       std::chrono::minutes{command_line::get_arg(args, opts.rates_interval)},
       command_line::get_arg(args, opts.scan_threads),
       command_line::get_arg(args, opts.create_queue_max),
-      command_line::get_arg(args, opts.untrusted_daemon)
+      command_line::get_arg(args, opts.untrusted_daemon),
+      command_line::get_arg(args, opts.scan_work_pool),
+      command_line::get_arg(args, opts.scan_index),
+      command_line::get_arg(args, opts.pow_fast_mode)
     };
 
     prog.rest_config.threads = std::max(std::size_t(1), prog.rest_config.threads);
@@ -280,14 +325,20 @@ namespace
     std::signal(SIGINT, [] (int) { lws::scanner::stop(); });
 
     boost::filesystem::create_directories(prog.db_path);
-    auto disk = lws::db::storage::open(prog.db_path.c_str(), prog.create_queue_max);
+    auto disk = lws::db::storage::open(prog.db_path.c_str(), prog.create_queue_max, prog.db_opts);
     auto ctx = lws::rpc::context::make(std::move(prog.daemon_rpc), std::move(prog.daemon_sub), std::move(prog.zmq_pub), std::move(prog.rmq), prog.rates_interval, prog.untrusted_daemon);
 
     MINFO("Using monerod ZMQ RPC at " << ctx.daemon_address());
     auto client = lws::scanner::sync(disk.clone(), ctx.connect().value(), prog.untrusted_daemon).value();
 
-    const auto enable_subaddresses = bool(prog.rest_config.max_subaddresses);
-    const auto webhook_verify = prog.rest_config.webhook_verify;
+    const lws::scanner_options scan_opts{
+      prog.rest_config.webhook_verify,
+      bool(prog.rest_config.max_subaddresses),
+      prog.untrusted_daemon,
+      prog.scan_work_pool,
+      prog.scan_index,
+      prog.pow_fast_mode
+    };
     lws::rest_server server{
       epee::to_span(prog.rest_servers), prog.admin_rest_servers, disk.clone(), std::move(client), std::move(prog.rest_config)
     };
@@ -297,7 +348,7 @@ namespace
       MINFO("Listening for REST admin clients at " << address);
 
     // blocks until SIGINT
-    lws::scanner::run(std::move(disk), std::move(ctx), prog.scan_threads, webhook_verify, enable_subaddresses, prog.untrusted_daemon);
+    lws::scanner::run(std::move(disk), std::move(ctx), prog.scan_threads, scan_opts);
   }
 } // anonymous
 
@@ -27,6 +27,11 @@
 
 #include "blocks.h"
 
+#include <algorithm>
+#include <boost/multiprecision/cpp_int.hpp>
+#include <cassert>
+#include <limits>
+
 #include "cryptonote_config.h" // monero/src
 #include "crypto/hash-ops.h"   // monero/src
 #include "db/storage.h"
@@ -36,8 +41,50 @@
 
 namespace lws
 {
+  namespace
+  {
+    // `DIFFICULTY_BLOCKS_COUNT` macro is not parenthesized
+    constexpr const std::size_t difficulty_count = DIFFICULTY_BLOCKS_COUNT;
+    constexpr const std::size_t difficulty_window_size = DIFFICULTY_WINDOW;
+    constexpr const std::size_t difficulty_kept = DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT;
+    constexpr const std::size_t timestamp_window = BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW;
+    static_assert(2 <= difficulty_kept, "invalid DIFFICULTY_CUT value");
+    static_assert(difficulty_window_size <= difficulty_count, "invalid DIFFICULTY_LAG value");
+
+    void insert_sorted(std::vector<std::uint64_t>& sorted, const std::uint64_t value)
+    {
+      sorted.insert(std::upper_bound(sorted.begin(), sorted.end(), value), value);
+    }
+
+    void erase_sorted(std::vector<std::uint64_t>& sorted, const std::uint64_t value)
+    {
+      const auto elem = std::lower_bound(sorted.begin(), sorted.end(), value);
+      assert(elem != sorted.end() && *elem == value);
+      sorted.erase(elem);
+    }
+  }
+
+  crypto::hash get_seed_hash(
+    const db::block_id height, const unsigned major_version, const db::storage& disk, const db::block_id cached_start, epee::span<const crypto::hash> cached)
+  {
+    crypto::hash hash{};
+    if (major_version < RX_BLOCK_VERSION || height == db::block_id(0))
+      return hash; // zero hash only happens when generating genesis block
+
+    const uint64_t seed_height = crypto::rx_seedheight(std::uint64_t(height));
+    if (cached_start <= db::block_id(seed_height))
+    {
+      if (cached.size() <= seed_height - std::uint64_t(cached_start))
+        MONERO_THROW(error::bad_blockchain, "invalid seed_height for cache or DB");
+      hash = cached[seed_height - std::uint64_t(cached_start)];
+    }
+    else
+      hash = MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_block_hash(db::block_id(seed_height)));
+    return hash;
+  }
+
   crypto::hash get_block_longhash(
-    const std::string& bd, const db::block_id height, const unsigned major_version, const db::storage& disk, const db::block_id cached_start, epee::span<const crypto::hash> cached)
+    const std::string& bd, const db::block_id height, const unsigned major_version, const crypto::hash& seed)
   {
     crypto::hash result{};
 
@@ -49,32 +96,23 @@ namespace lws
       return result;
     }
     if (major_version >= RX_BLOCK_VERSION)
+      crypto::rx_slow_hash(seed.data, bd.data(), bd.size(), result.data);
+    else
     {
-      crypto::hash hash{};
-      if (height != db::block_id(0))
-      {
-        const uint64_t seed_height = crypto::rx_seedheight(std::uint64_t(height));
-        if (cached_start <= db::block_id(seed_height))
-        {
-          if (cached.size() <= seed_height - std::uint64_t(cached_start))
-            MONERO_THROW(error::bad_blockchain, "invalid seed_height for cache or DB");
-          hash = cached[seed_height - std::uint64_t(cached_start)];
-        }
-        else
-          hash = MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_block_hash(db::block_id(seed_height)));
-      }
-      else
-      {
-        memset(&result, 0, sizeof(crypto::hash));  // only happens when generating genesis block
-      }
-      crypto::rx_slow_hash(hash.data, bd.data(), bd.size(), result.data);
-    } else {
       const int pow_variant = major_version >= 7 ? major_version - 6 : 0;
       crypto::cn_slow_hash(bd.data(), bd.size(), result, pow_variant, std::uint64_t(height));
     }
     return result;
   }
 
+  crypto::hash get_block_longhash(
+    const std::string& bd, const db::block_id height, const unsigned major_version, const db::storage& disk, const db::block_id cached_start, epee::span<const crypto::hash> cached)
+  {
+    return get_block_longhash(
+      bd, height, major_version, get_seed_hash(height, major_version, disk, cached_start, cached)
+    );
+  }
+
   bool verify_timestamp(std::uint64_t check, std::vector<std::uint64_t> timestamps)
   {
     if (timestamps.empty())
@@ -83,5 +121,109 @@ namespace lws
       return false;
     return true;
   }
-}
 
+  difficulty_window::difficulty_window()
+    : timestamps_(difficulty_count),
+      cumulative_diffs_(difficulty_count),
+      sorted_(),
+      recent_(timestamp_window),
+      recent_sorted_()
+  {
+    sorted_.reserve(difficulty_window_size);
+    recent_sorted_.reserve(timestamp_window);
+  }
+
+  difficulty_window::difficulty_window(const db::pow_window& source)
+    : difficulty_window()
+  {
+    assert(source.pow_timestamps.size() == source.cumulative_diffs.size());
+    const std::size_t count =
+      std::min(source.pow_timestamps.size(), source.cumulative_diffs.size());
+    for (std::size_t i = 0; i < count; ++i)
+      push_difficulty(source.pow_timestamps[i], source.cumulative_diffs[i]);
+    for (const std::uint64_t timestamp : source.median_timestamps)
+      push_recent(timestamp);
+  }
+
+  void difficulty_window::push_difficulty(const std::uint64_t timestamp, const db::block_difficulty::unsigned_int& cumulative)
+  {
+    // `sorted_` always has the oldest `DIFFICULTY_WINDOW` timestamps
+    if (timestamps_.full())
+    {
+      erase_sorted(sorted_, timestamps_.front());
+      timestamps_.pop_front();
+      cumulative_diffs_.pop_front();
+      if (difficulty_window_size <= timestamps_.size())
+        insert_sorted(sorted_, timestamps_[difficulty_window_size - 1]);
+    }
+    if (timestamps_.size() < difficulty_window_size)
+      insert_sorted(sorted_, timestamp);
+    timestamps_.push_back(timestamp);
+    cumulative_diffs_.push_back(cumulative);
+  }
+
+  void difficulty_window::push_recent(const std::uint64_t timestamp)
+  {
+    if (recent_.full())
+    {
+      erase_sorted(recent_sorted_, recent_.front());
+      recent_.pop_front();
+    }
+    insert_sorted(recent_sorted_, timestamp);
+    recent_.push_back(timestamp);
+  }
+
+  db::block_difficulty::unsigned_int difficulty_window::next_difficulty(const std::uint64_t target_seconds) const
+  {
+    // mirrors `cryptonote::next_difficulty`, without the copy and sort
+    const std::size_t length = std::min(timestamps_.size(), difficulty_window_size);
+    if (length <= 1)
+      return 1;
+
+    std::size_t cut_begin = 0;
+    std::size_t cut_end = length;
+    if (difficulty_kept < length)
+    {
+      cut_begin = (length - difficulty_kept + 1) / 2;
+      cut_end = cut_begin + difficulty_kept;
+    }
+
+    std::uint64_t time_span = sorted_[cut_end - 1] - sorted_[cut_begin];
+    if (time_span == 0)
+      time_span = 1;
+
+    const db::block_difficulty::unsigned_int total_work =
+      cumulative_diffs_[cut_end - 1] - cumulative_diffs_[cut_begin];
+    const boost::multiprecision::uint256_t result =
+      (boost::multiprecision::uint256_t(total_work) * target_seconds + time_span - 1) / time_span;
+    if (boost::multiprecision::uint256_t(std::numeric_limits<db::block_difficulty::unsigned_int>::max()) < result)
+      return 0;
+    return result.convert_to<db::block_difficulty::unsigned_int>();
+  }
+
+  bool difficulty_window::verify_timestamp(const std::uint64_t check) const noexcept
+  {
+    // mirrors `epee::misc_utils::median`
+    if (recent_sorted_.empty())
+      return true;
+
+    const std::size_t middle = recent_sorted_.size() / 2;
+    std::uint64_t median = recent_sorted_[middle];
+    if (recent_sorted_.size() % 2 == 0)
+      median = (recent_sorted_[middle - 1] + recent_sorted_[middle]) / 2;
+    return median <= check;
+  }
+
+  db::block_difficulty::unsigned_int difficulty_window::cumulative_difficulty() const
+  {
+    if (cumulative_diffs_.empty())
+      return 0;
+    return cumulative_diffs_.back();
+  }
+
+  void difficulty_window::push(const std::uint64_t timestamp, const db::block_difficulty::unsigned_int& difficulty)
+  {
+    push_difficulty(timestamp, cumulative_difficulty() + difficulty);
+    push_recent(timestamp);
+  }
+}
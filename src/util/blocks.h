@@ -25,7 +25,10 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <boost/circular_buffer.hpp>
+#include <cstdint>
 #include <string>
+#include <vector>
 #include "crypto/hash.h"
 #include "db/data.h"
 #include "db/fwd.h"
@@ -33,8 +36,53 @@
 
 namespace lws
 {
+  //! \return RandomX seed hash for `height`, from `cached` or `disk`. Zero before RandomX.
+  crypto::hash get_seed_hash(
+    const db::block_id height, const unsigned major_version, const db::storage& disk, db::block_id cached_start, epee::span<const crypto::hash> cached);
+
+  //! \return PoW hash of `bd`, with `seed` from `get_seed_hash`. Thread-safe.
+  crypto::hash get_block_longhash(
+    const std::string& bd, const db::block_id height, const unsigned major_version, const crypto::hash& seed);
+
   crypto::hash get_block_longhash(
     const std::string& bd, const db::block_id height, const unsigned major_version, const db::storage& disk, db::block_id cached_start, epee::span<const crypto::hash> cached);
 
   bool verify_timestamp(std::uint64_t verify, std::vector<std::uint64_t> timestamps);
+
+  /*!
+    Incremental replacement for `db::pow_window` + `cryptonote::next_difficulty`
+    + `verify_timestamp`. Timestamps and cumulative difficulties are kept in
+    ring buffers, with sorted copies of the two timestamp windows so that the
+    difficulty cut points and timestamp median are direct lookups. Results
+    are identical to the monero functions. */
+  class difficulty_window
+  {
+    boost::circular_buffer<std::uint64_t> timestamps_; //!< Chain order, for difficulty
+    boost::circular_buffer<db::block_difficulty::unsigned_int> cumulative_diffs_;
+    std::vector<std::uint64_t> sorted_; //!< Sorted oldest `DIFFICULTY_WINDOW` of `timestamps_`
+    boost::circular_buffer<std::uint64_t> recent_; //!< Chain order, for timestamp check
+    std::vector<std::uint64_t> recent_sorted_;
+
+    void push_difficulty(std::uint64_t timestamp, const db::block_difficulty::unsigned_int& cumulative);
+    void push_recent(std::uint64_t timestamp);
+
+  public:
+    //! Empty window, for chains without blocks
+    difficulty_window();
+
+    //! Window for the block after the last block in `source`.
+    explicit difficulty_window(const db::pow_window& source);
+
+    //! \return Difficulty of next block, same as `cryptonote::next_difficulty`.
+    db::block_difficulty::unsigned_int next_difficulty(std::uint64_t target_seconds) const;
+
+    //! \return Same as `verify_timestamp(check, <timestamp window>)`.
+    bool verify_timestamp(std::uint64_t check) const noexcept;
+
+    //! \return Cumulative difficulty of last block, or 0 if none.
+    db::block_difficulty::unsigned_int cumulative_difficulty() const;
+
+    //! Add next block with `timestamp` and `difficulty` from `next_difficulty`.
+    void push(std::uint64_t timestamp, const db::block_difficulty::unsigned_int& difficulty);
+  };
 }
@@ -27,11 +27,138 @@
 
 #include "transactions.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#if defined(__AVX2__) || defined(__SSE2__)
+  #include <immintrin.h>
+#endif
+
 #include "cryptonote_config.h"
 #include "crypto/crypto.h"
 #include "crypto/hash.h"
 #include "ringct/rctOps.h"
 
+extern "C"
+{
+#include "crypto/crypto-ops.h"
+}
+
+namespace
+{
+  //! `fe` is an array type, which cannot be stored directly in `std::vector`
+  struct field_element
+  {
+    fe value;
+  };
+
+  // below are copies of static functions in monero/src/crypto/crypto-ops.c
+
+  unsigned char equal(const signed char b, const signed char c) noexcept
+  {
+    const unsigned char ub = b;
+    const unsigned char uc = c;
+    const unsigned char x = ub ^ uc; /* 0: yes; 1..255: no */
+    std::uint32_t y = x;             /* 0: yes; 1..255: no */
+    y -= 1;                          /* 4294967295: yes; 0..254: no */
+    y >>= 31;                        /* 1: yes; 0: no */
+    return y;
+  }
+
+  unsigned char negative(const signed char b) noexcept
+  {
+    unsigned long long x = b; /* 18446744073709551361..18446744073709551615: yes; 0..255: no */
+    x >>= 63;                 /* 1: yes; 0: no */
+    return x;
+  }
+
+  void fe_cmov(fe f, const fe g, const unsigned char b) noexcept
+  {
+    const std::int32_t mask = -std::int32_t(b);
+    for (unsigned i = 0; i < 10; ++i)
+      f[i] ^= (f[i] ^ g[i]) & mask;
+  }
+
+  void ge_cached_cmov(ge_cached& t, const ge_cached& u, const unsigned char b) noexcept
+  {
+    fe_cmov(t.YplusX, u.YplusX, b);
+    fe_cmov(t.YminusX, u.YminusX, b);
+    fe_cmov(t.Z, u.Z, b);
+    fe_cmov(t.T2d, u.T2d, b);
+  }
+
+  void fe_set(fe h, const std::int32_t value) noexcept
+  {
+    h[0] = value;
+    for (unsigned i = 1; i < 10; ++i)
+      h[i] = 0;
+  }
+
+  //! `table[i]` is `(i + 1) * A`, same as `Ai` in `ge_scalarmult`.
+  using multiples = ge_cached[8];
+
+  void compute_multiples(multiples& table, const ge_p3& A) noexcept
+  {
+    ge_p1p1 t;
+    ge_p3 u;
+    ge_p3_to_cached(std::addressof(table[0]), std::addressof(A));
+    for (unsigned i = 0; i < 7; ++i)
+    {
+      ge_add(std::addressof(t), std::addressof(A), std::addressof(table[i]));
+      ge_p1p1_to_p3(std::addressof(u), std::addressof(t));
+      ge_p3_to_cached(std::addressof(table[i + 1]), std::addressof(u));
+    }
+  }
+
+  /*! Same as `ge_scalarmult`, except the scalar recoding and multiples of
+    `A` are provided by the caller. Constant time with respect to `e`. */
+  void scalarmult(ge_p2& r, const std::array<std::int8_t, 64>& e, const multiples& table) noexcept
+  {
+    ge_p1p1 t;
+    ge_p3 u;
+
+    fe_set(r.X, 0);
+    fe_set(r.Y, 1);
+    fe_set(r.Z, 1);
+
+    for (unsigned i = 64; i > 0; --i)
+    {
+      const signed char b = e[i - 1];
+      const unsigned char bnegative = negative(b);
+      const unsigned char babs = b - (((-bnegative) & b) << 1);
+
+      ge_p2_dbl(std::addressof(t), std::addressof(r));
+      ge_p1p1_to_p2(std::addressof(r), std::addressof(t));
+      ge_p2_dbl(std::addressof(t), std::addressof(r));
+      ge_p1p1_to_p2(std::addressof(r), std::addressof(t));
+      ge_p2_dbl(std::addressof(t), std::addressof(r));
+      ge_p1p1_to_p2(std::addressof(r), std::addressof(t));
+      ge_p2_dbl(std::addressof(t), std::addressof(r));
+      ge_p1p1_to_p3(std::addressof(u), std::addressof(t));
+
+      ge_cached cur;
+      fe_set(cur.YplusX, 1);
+      fe_set(cur.YminusX, 1);
+      fe_set(cur.Z, 1);
+      fe_set(cur.T2d, 0);
+      for (unsigned j = 0; j < 8; ++j)
+        ge_cached_cmov(cur, table[j], equal(babs, static_cast<signed char>(j + 1)));
+
+      ge_cached minuscur;
+      std::memcpy(minuscur.YplusX, cur.YminusX, sizeof(fe));
+      std::memcpy(minuscur.YminusX, cur.YplusX, sizeof(fe));
+      std::memcpy(minuscur.Z, cur.Z, sizeof(fe));
+      for (unsigned j = 0; j < 10; ++j)
+        minuscur.T2d[j] = -cur.T2d[j];
+      ge_cached_cmov(cur, minuscur, bnegative);
+
+      ge_add(std::addressof(t), std::addressof(u), std::addressof(cur));
+      ge_p1p1_to_p2(std::addressof(r), std::addressof(t));
+    }
+  }
+}
+
 void lws::decrypt_payment_id(crypto::hash8& out, const crypto::key_derivation& key)
 {
   crypto::hash hash;
@@ -59,3 +186,102 @@ boost::optional<std::pair<std::uint64_t, rct::key>> lws::decode_amount(const rct
     return {{rct::h2d(copy.amount), copy.mask}};
   return boost::none;
 }
+
+bool lws::generate_key_derivations(std::vector<crypto::key_derivation>& out, const crypto::public_key& tx_pub, const epee::span<const std::array<std::int8_t, 64>* const> view_keys)
+{
+  out.clear();
+
+  ge_p3 point;
+  if (ge_frombytes_vartime(std::addressof(point), reinterpret_cast<const unsigned char*>(tx_pub.data)) != 0)
+    return false;
+
+  if (view_keys.empty())
+    return true;
+
+  multiples table;
+  compute_multiples(table, point);
+
+  // 8 * view_key * tx_pub, kept in projective coordinates
+  std::vector<ge_p2> points;
+  points.resize(view_keys.size());
+  for (std::size_t i = 0; i < view_keys.size(); ++i)
+  {
+    ge_p2 scaled;
+    ge_p1p1 multiplied;
+    scalarmult(scaled, *view_keys[i], table);
+    ge_mul8(std::addressof(multiplied), std::addressof(scaled));
+    ge_p1p1_to_p2(std::addressof(points[i]), std::addressof(multiplied));
+  }
+
+  /* Montgomery batch inversion: `products[i]` is `Z[0] * ... * Z[i]`. A
+    single inversion of the last product yields every `1 / Z[i]` when
+    walked backwards. */
+  std::vector<field_element> products;
+  products.resize(points.size());
+  std::memcpy(products[0].value, points[0].Z, sizeof(fe));
+  for (std::size_t i = 1; i < points.size(); ++i)
+    fe_mul(products[i].value, products[i - 1].value, points[i].Z);
+
+  fe inverse;
+  fe_invert(inverse, products.back().value);
+
+  out.resize(points.size());
+  for (std::size_t i = points.size(); i > 0; --i)
+  {
+    const std::size_t current = i - 1;
+
+    fe z_inverse;
+    if (current)
+    {
+      fe_mul(z_inverse, inverse, products[current - 1].value);
+      fe_mul(inverse, inverse, points[current].Z);
+    }
+    else
+      std::memcpy(z_inverse, inverse, sizeof(fe));
+
+    // same encoding as `ge_tobytes`
+    fe x;
+    fe y;
+    unsigned char x_bytes[32];
+    unsigned char* const dest = reinterpret_cast<unsigned char*>(out[current].data);
+
+    fe_mul(x, points[current].X, z_inverse);
+    fe_mul(y, points[current].Y, z_inverse);
+    fe_tobytes(dest, y);
+    fe_tobytes(x_bytes, x);
+    dest[31] ^= (x_bytes[0] & 1) << 7;
+  }
+
+  return true;
+}
+
+void lws::match_view_tags(std::vector<std::uint32_t>& out, const epee::span<const std::uint8_t> expected, const epee::span<const std::uint8_t> tags)
+{
+  assert(expected.size() == tags.size());
+  const std::size_t count = std::min(expected.size(), tags.size());
+
+  std::size_t i = 0;
+#if defined(__AVX2__)
+  for ( ; i + 32 <= count; i += 32)
+  {
+    const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(expected.data() + i));
+    const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tags.data() + i));
+    for (std::uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(left, right)); mask; mask &= mask - 1)
+      out.push_back(std::uint32_t(i + __builtin_ctz(mask)));
+  }
+#endif
+#if defined(__SSE2__)
+  for ( ; i + 16 <= count; i += 16)
+  {
+    const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(expected.data() + i));
+    const __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags.data() + i));
+    for (std::uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(left, right)); mask; mask &= mask - 1)
+      out.push_back(std::uint32_t(i + __builtin_ctz(mask)));
+  }
+#endif
+  for ( ; i < count; ++i)
+  {
+    if (expected[i] == tags[i])
+      out.push_back(std::uint32_t(i));
+  }
+}
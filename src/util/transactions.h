@@ -25,21 +25,47 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <array>
 #include <boost/optional/optional.hpp>
 #include <cstdint>
 #include <utility>
+#include <vector>
 
 #include "common/pod-class.h"
+#include "crypto/crypto.h" // monero/src
 #include "ringct/rctTypes.h"
+#include "span.h"          // monero/contrib/epee/include
 
 namespace crypto
 {
   POD_CLASS hash8;
-  POD_CLASS key_derivation;
 }
 
 namespace lws
 {
   void decrypt_payment_id(crypto::hash8& out, const crypto::key_derivation& key);
   boost::optional<std::pair<std::uint64_t, rct::key>> decode_amount(const rct::key& commitment, const rct::ecdhTuple& info, const crypto::key_derivation& sk, std::size_t index, const bool bulletproof2);
+
+  /*!
+    Computes the key derivation of `tx_pub` for every view key in
+    `view_keys`. Each result is identical to `crypto::generate_key_derivation`,
+    but the multiples of `tx_pub` are computed once for the entire batch, and
+    the point compressions share a single field inversion.
+
+    \param[out] out Resized to `view_keys.size()`, `out[i]` is the
+      derivation for `*view_keys[i]`.
+    \param tx_pub Public key from the tx extra.
+    \param view_keys Secret view keys recoded as signed radix-16 digits (see
+      `lws::account::view_key_digits()`), none can be `nullptr`.
+    \return False if `tx_pub` is not a valid point, and `out` is empty. */
+  bool generate_key_derivations(std::vector<crypto::key_derivation>& out, const crypto::public_key& tx_pub, epee::span<const std::array<std::int8_t, 64>* const> view_keys);
+
+  /*!
+    Compares two columns of view tags, 32 or 16 at a time when compiled with
+    AVX2 or SSE2 support, otherwise one at a time.
+
+    \param[out] out Position of every match is appended, in order.
+    \param expected View tags derived for one account.
+    \param tags View tags from the outputs, same size as `expected`. */
+  void match_view_tags(std::vector<std::uint32_t>& out, epee::span<const std::uint8_t> expected, epee::span<const std::uint8_t> tags);
 }
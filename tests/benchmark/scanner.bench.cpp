@@ -0,0 +1,791 @@
+// Copyright (c) 2024, The Monero Project
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <atomic>
+#include <boost/filesystem/operations.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/thread/thread.hpp>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/command_line.h"                      // monero/src
+#include "common/expect.h"                            // monero/src
+#include "common/util.h"                              // monero/src
+#include "crypto/crypto.h"                            // monero/src
+#include "cryptonote_basic/account.h"                 // monero/src
+#include "cryptonote_basic/cryptonote_basic.h"        // monero/src
+#include "cryptonote_basic/cryptonote_format_utils.h" // monero/src
+#include "cryptonote_config.h"                        // monero/src
+#include "db/data.h"
+#include "db/storage.h"
+#include "device/device_default.hpp"                  // monero/src
+#include "misc_log_ex.h"                              // monero/contrib/epee/include
+#include "net/zmq.h"                                  // monero/src
+#include "rapidjson/document.h"                       // monero/external
+#include "ringct/rctOps.h"                            // monero/src
+#include "rpc/client.h"
+#include "rpc/daemon_messages.h"                      // monero/src
+#include "scanner.h"
+#include "string_tools.h"                             // monero/contrib/epee/include
+
+/*
+  Measures `lws::scanner` throughput against a synthetic chain served by an
+  in-process fake daemon, so scanner changes can be compared on one machine
+  without `monerod`. Transactions have valid output keys, view tags, and
+  encrypted amounts, but no signatures or range proofs; the scanner runs in
+  trusted daemon mode, which does not verify those. */
+
+namespace
+{
+  constexpr const char daemon_address[] = "inproc://benchmark_daemon";
+  constexpr const std::size_t ring_size = 16;
+  constexpr const std::uint64_t output_amount = 1000000;
+  constexpr const std::uint64_t tx_fee = 30000;
+  constexpr const std::uint64_t block_time = 120;
+
+  struct options
+  {
+    const command_line::arg_descriptor<std::uint64_t> blocks;
+    const command_line::arg_descriptor<std::uint64_t> txes;
+    const command_line::arg_descriptor<std::uint32_t> outputs;
+    const command_line::arg_descriptor<std::uint32_t> inputs;
+    const command_line::arg_descriptor<std::uint32_t> accounts;
+    const command_line::arg_descriptor<std::uint32_t> subaddresses;
+    const command_line::arg_descriptor<double> hit_rate;
+    const command_line::arg_descriptor<double> subaddress_rate;
+    const command_line::arg_descriptor<double> tag_hit_rate;
+    const command_line::arg_descriptor<double> untagged_rate;
+    const command_line::arg_descriptor<std::uint32_t> batch;
+    const command_line::arg_descriptor<std::size_t> threads;
+    const command_line::arg_descriptor<bool> work_pool;
+    const command_line::arg_descriptor<unsigned short> log_level;
+
+    options()
+      : blocks{"blocks", "Number of synthetic blocks to scan", 1000}
+      , txes{"txes", "Non-coinbase transactions per block", 10}
+      , outputs{"outputs", "Outputs per transaction", 2}
+      , inputs{"inputs", "Inputs per transaction", 1}
+      , accounts{"accounts", "Number of accounts scanned", 100}
+      , subaddresses{"subaddresses", "Subaddresses per account, enables subaddress scanning if non-zero", 0}
+      , hit_rate{"hit-rate", "Fraction of outputs received by a scanned account", 0.01}
+      , subaddress_rate{"subaddress-rate", "Fraction of received outputs sent to a subaddress", 0.5}
+      , tag_hit_rate{"tag-hit-rate", "Fraction of other outputs with a view tag matching a scanned account", 0.01}
+      , untagged_rate{"untagged-rate", "Fraction of transactions without view tags", 0}
+      , batch{"batch", "Blocks per get_blocks_fast response", 100}
+      , threads{"threads", "Scan threads", 1}
+      , work_pool{"work-pool", "Scan with tasks on the compute threadpool", false}
+      , log_level{"log-level", "Log level [0-4]", 0}
+    {}
+
+    void prepare(boost::program_options::options_description& description) const
+    {
+      command_line::add_arg(description, blocks);
+      command_line::add_arg(description, txes);
+      command_line::add_arg(description, outputs);
+      command_line::add_arg(description, inputs);
+      command_line::add_arg(description, accounts);
+      command_line::add_arg(description, subaddresses);
+      command_line::add_arg(description, hit_rate);
+      command_line::add_arg(description, subaddress_rate);
+      command_line::add_arg(description, tag_hit_rate);
+      command_line::add_arg(description, untagged_rate);
+      command_line::add_arg(description, batch);
+      command_line::add_arg(description, threads);
+      command_line::add_arg(description, work_pool);
+      command_line::add_arg(description, log_level);
+      command_line::add_arg(description, command_line::arg_help);
+    }
+  };
+
+  struct settings
+  {
+    std::uint64_t blocks;
+    std::uint64_t txes;
+    std::uint32_t outputs;
+    std::uint32_t inputs;
+    std::uint32_t accounts;
+    std::uint32_t subaddresses;
+    double hit_rate;
+    double subaddress_rate;
+    double tag_hit_rate;
+    double untagged_rate;
+    std::uint32_t batch;
+    std::size_t threads;
+    bool work_pool;
+  };
+
+  struct bench_account
+  {
+    cryptonote::account_keys keys;
+    std::vector<cryptonote::account_public_address> subaddresses; //!< Minor index `i + 1`
+  };
+
+  //! Synthetic blocks, starting at `base + 1`.
+  struct chain
+  {
+    std::uint64_t base = 0;
+    std::vector<cryptonote::rpc::block_with_transactions> blocks;
+    std::vector<std::vector<std::vector<std::uint64_t>>> indices;
+    std::vector<crypto::hash> hashes; //!< `hashes[0]` is at `base`
+    std::unordered_map<crypto::hash, std::uint64_t> heights;
+
+    // excludes first block, which is only the overlap block for scanning
+    std::uint64_t txes = 0;
+    std::uint64_t outputs = 0;
+    std::uint64_t received = 0;    //!< Outputs sent to scanned accounts
+    std::uint64_t derivations = 0; //!< Key derivations needed to scan all accounts
+
+    std::uint64_t top() const noexcept { return base + blocks.size(); }
+  };
+
+  //! Wall time of each benchmark stage, printed in order.
+  class stages
+  {
+    std::vector<std::pair<std::string, double>> times_;
+    std::chrono::steady_clock::time_point start_;
+
+  public:
+    stages()
+      : times_(), start_(std::chrono::steady_clock::now())
+    {}
+
+    //! \return Seconds since last call, recorded as `name`.
+    double finish(std::string name)
+    {
+      const auto now = std::chrono::steady_clock::now();
+      const double elapsed = std::chrono::duration<double>(now - start_).count();
+      times_.emplace_back(std::move(name), elapsed);
+      start_ = now;
+      return elapsed;
+    }
+
+    void print(std::ostream& out) const
+    {
+      for (const auto& stage : times_)
+        out << "  " << std::left << std::setw(12) << stage.first << std::right << std::setw(10) << stage.second << " s" << std::endl;
+    }
+  };
+
+  class generator
+  {
+    const settings& opts_;
+    const std::vector<bench_account>& accounts_;
+    std::mt19937_64 random_;
+    std::uint64_t next_index_; //!< Next global output index
+
+    bool chance(const double probability)
+    {
+      return std::uniform_real_distribution<double>{}(random_) < probability;
+    }
+
+    std::uint64_t pick(const std::uint64_t count)
+    {
+      return std::uniform_int_distribution<std::uint64_t>{0, count - 1}(random_);
+    }
+
+    static crypto::public_key multiply(const crypto::public_key& point, const crypto::secret_key& scalar)
+    {
+      return rct::rct2pk(rct::scalarmultKey(rct::pk2rct(point), rct::sk2rct(scalar)));
+    }
+
+    static void add_output(cryptonote::transaction& tx, const crypto::public_key& key, const bool tagged, const crypto::view_tag& tag, const crypto::secret_key& scalar)
+    {
+      cryptonote::tx_out out{};
+      cryptonote::set_tx_out(0, key, tagged, tag, out);
+      tx.vout.push_back(std::move(out));
+
+      rct::ecdhTuple info{};
+      info.amount = rct::d2h(output_amount);
+      rct::ecdhEncode(info, rct::sk2rct(scalar), true);
+      tx.rct_signatures.ecdhInfo.push_back(info);
+      tx.rct_signatures.outPk.push_back(
+        rct::ctkey{rct::pk2rct(key), rct::commit(output_amount, rct::genCommitmentMask(rct::sk2rct(scalar)))}
+      );
+    }
+
+    cryptonote::transaction make_miner_tx(const std::uint64_t height)
+    {
+      cryptonote::transaction tx{};
+      crypto::public_key tx_pub{};
+      crypto::secret_key tx_sec{};
+      crypto::generate_keys(tx_pub, tx_sec);
+      cryptonote::add_tx_pub_key_to_extra(tx, tx_pub);
+
+      cryptonote::txin_gen in{};
+      in.height = height;
+      tx.vin.push_back(in);
+
+      cryptonote::tx_out out{};
+      cryptonote::set_tx_out(output_amount, crypto::rand<crypto::public_key>(), true, crypto::view_tag{}, out);
+      tx.vout.push_back(std::move(out));
+
+      tx.version = 2;
+      tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+      tx.rct_signatures.type = rct::RCTTypeNull;
+      return tx;
+    }
+
+    cryptonote::transaction make_tx(chain& out)
+    {
+      struct recipient
+      {
+        const bench_account* account;
+        std::uint32_t minor;
+      };
+
+      cryptonote::transaction tx{};
+      tx.version = 2;
+
+      for (std::uint32_t i = 0; i < opts_.inputs; ++i)
+      {
+        cryptonote::txin_to_key in{};
+        in.amount = 0;
+        in.k_image = crypto::rand<crypto::key_image>();
+        for (std::size_t j = 0; j < ring_size; ++j)
+          in.key_offsets.push_back(next_index_ ? pick(next_index_) : 0);
+        std::sort(in.key_offsets.begin(), in.key_offsets.end());
+        in.key_offsets = cryptonote::absolute_output_offsets_to_relative(in.key_offsets);
+        tx.vin.push_back(std::move(in));
+      }
+
+      bool additional = false;
+      std::vector<recipient> recipients{};
+      for (std::uint32_t i = 0; i < opts_.outputs; ++i)
+      {
+        recipients.push_back({nullptr, 0});
+        if (!accounts_.empty() && chance(opts_.hit_rate))
+        {
+          recipients.back().account = std::addressof(accounts_[pick(accounts_.size())]);
+          if (opts_.subaddresses && chance(opts_.subaddress_rate))
+          {
+            recipients.back().minor = std::uint32_t(pick(opts_.subaddresses) + 1);
+            additional = true;
+          }
+          ++out.received;
+        }
+      }
+
+      const bool tagged = !chance(opts_.untagged_rate);
+      crypto::public_key tx_pub{};
+      crypto::secret_key tx_sec{};
+      crypto::generate_keys(tx_pub, tx_sec);
+      cryptonote::add_tx_pub_key_to_extra(tx, tx_pub);
+
+      std::vector<crypto::public_key> additional_pubs{};
+      for (std::size_t i = 0; i < recipients.size(); ++i)
+      {
+        crypto::secret_key key_sec = tx_sec;
+        crypto::public_key key_pub = tx_pub;
+        if (additional)
+          crypto::generate_keys(key_pub, key_sec);
+
+        crypto::public_key key{};
+        crypto::view_tag tag{};
+        crypto::secret_key scalar{};
+        crypto::key_derivation derivation{};
+
+        const recipient& dest = recipients[i];
+        if (dest.account)
+        {
+          const cryptonote::account_public_address& address = dest.minor ?
+            dest.account->subaddresses.at(dest.minor - 1) : dest.account->keys.m_account_address;
+          if (additional && dest.minor)
+            key_pub = multiply(address.m_spend_public_key, key_sec);
+
+          if (!crypto::generate_key_derivation(address.m_view_public_key, key_sec, derivation))
+            throw std::runtime_error{"Failed to generate key derivation"};
+          if (!crypto::derive_public_key(derivation, i, address.m_spend_public_key, key))
+            throw std::runtime_error{"Failed to derive output key"};
+          crypto::derive_view_tag(derivation, i, tag);
+          crypto::derivation_to_scalar(derivation, i, scalar);
+        }
+        else
+        {
+          key = crypto::rand<crypto::public_key>();
+          tag.data = char(pick(256));
+          if (tagged && !accounts_.empty() && chance(opts_.tag_hit_rate))
+          {
+            // view tag matches, full derivation needed to reject
+            const bench_account& other = accounts_[pick(accounts_.size())];
+            if (!crypto::generate_key_derivation(other.keys.m_account_address.m_view_public_key, key_sec, derivation))
+              throw std::runtime_error{"Failed to generate key derivation"};
+            crypto::derive_view_tag(derivation, i, tag);
+          }
+          scalar = rct::rct2sk(rct::skGen());
+        }
+
+        if (additional)
+          additional_pubs.push_back(key_pub);
+        add_output(tx, key, tagged, tag, scalar);
+      }
+
+      if (additional)
+        cryptonote::add_additional_tx_pub_keys_to_extra(tx.extra, additional_pubs);
+
+      tx.rct_signatures.type = rct::RCTTypeBulletproofPlus;
+      tx.rct_signatures.txnFee = tx_fee;
+
+      ++out.txes;
+      out.outputs += tx.vout.size();
+      out.derivations += accounts_.size() * (1 + additional_pubs.size());
+      return tx;
+    }
+
+  public:
+    generator(const settings& opts, const std::vector<bench_account>& accounts)
+      : opts_(opts), accounts_(accounts), random_(0), next_index_(0)
+    {}
+
+    chain make_chain(const lws::db::block_info& base)
+    {
+      chain out{};
+      out.base = std::uint64_t(base.id);
+      out.hashes.push_back(base.hash);
+      out.heights.emplace(base.hash, out.base);
+      out.blocks.reserve(opts_.blocks);
+      out.indices.reserve(opts_.blocks);
+
+      const std::uint64_t start_time = std::uint64_t(std::time(nullptr)) - opts_.blocks * block_time;
+      for (std::uint64_t i = 0; i < opts_.blocks; ++i)
+      {
+        const std::uint64_t height = out.base + 1 + i;
+
+        out.blocks.emplace_back();
+        out.indices.emplace_back();
+        cryptonote::rpc::block_with_transactions& entry = out.blocks.back();
+        auto& indices = out.indices.back();
+
+        entry.block.major_version = HF_VERSION_VIEW_TAGS;
+        entry.block.minor_version = HF_VERSION_VIEW_TAGS;
+        entry.block.timestamp = start_time + i * block_time;
+        entry.block.prev_id = out.hashes.back();
+        entry.block.nonce = std::uint32_t(i);
+        entry.block.miner_tx = make_miner_tx(height);
+
+        indices.emplace_back();
+        indices.back().push_back(next_index_++);
+        ++out.txes;
+        ++out.outputs;
+        out.derivations += accounts_.size();
+
+        for (std::uint64_t j = 0; j < opts_.txes; ++j)
+        {
+          entry.transactions.push_back(make_tx(out));
+          entry.block.tx_hashes.push_back(crypto::rand<crypto::hash>());
+
+          indices.emplace_back();
+          for (std::size_t k = 0; k < entry.transactions.back().vout.size(); ++k)
+            indices.back().push_back(next_index_++);
+        }
+
+        out.hashes.push_back(cryptonote::get_block_hash(entry.block));
+        out.heights.emplace(out.hashes.back(), height);
+
+        if (i == 0)
+        {
+          out.txes = 0;
+          out.outputs = 0;
+          out.received = 0;
+          out.derivations = 0;
+        }
+      }
+      return out;
+    }
+  };
+
+  template<typename T>
+  epee::byte_slice daemon_response(const T& message)
+  {
+    rapidjson::Value id;
+    id.SetInt(0);
+    return cryptonote::rpc::FullMessage::getResponse(message, id);
+  }
+
+  /*!
+    Answers `get_hashes_fast` and `get_blocks_fast` from `chain`, like
+    `monerod` would. Block responses for the heights requested by a single
+    account group are serialized before scanning starts, so serialization
+    cost is excluded from scan time. */
+  class fake_daemon
+  {
+    const chain& chain_;
+    const std::uint32_t batch_;
+    std::map<std::uint64_t, epee::byte_slice> prepared_;
+    std::uint64_t misses_;
+
+    epee::byte_slice make_blocks(std::uint64_t start) const
+    {
+      start = std::min(std::max(start, chain_.base + 1), chain_.top());
+      const std::uint64_t end = std::min(chain_.top(), start + batch_);
+      const std::size_t first = start - chain_.base - 1;
+      const std::size_t last = end - chain_.base;
+
+      cryptonote::rpc::GetBlocksFast::Response message{};
+      message.start_height = start;
+      message.current_height = chain_.top() + 1;
+      message.blocks.assign(chain_.blocks.begin() + first, chain_.blocks.begin() + last);
+      message.output_indices.assign(chain_.indices.begin() + first, chain_.indices.begin() + last);
+      return daemon_response(message);
+    }
+
+    epee::byte_slice make_hashes(const rapidjson::Value& known) const
+    {
+      std::uint64_t start = chain_.base;
+      if (known.IsArray())
+      {
+        for (rapidjson::SizeType i = 0; i < known.Size(); ++i)
+        {
+          const rapidjson::Value& elem = known[i];
+          crypto::hash hash{};
+          if (!elem.IsString() || !epee::string_tools::hex_to_pod(std::string{elem.GetString(), elem.GetStringLength()}, hash))
+            continue;
+          const auto height = chain_.heights.find(hash);
+          if (height != chain_.heights.end())
+          {
+            start = height->second;
+            break;
+          }
+        }
+      }
+
+      cryptonote::rpc::GetHashesFast::Response message{};
+      message.start_height = start;
+      message.current_height = chain_.top() + 1;
+      message.hashes.assign(chain_.hashes.begin() + (start - chain_.base), chain_.hashes.end());
+      return daemon_response(message);
+    }
+
+    epee::byte_slice respond(const std::string& request)
+    {
+      rapidjson::Document doc{};
+      doc.Parse(request.data(), request.size());
+      if (!doc.HasParseError() && doc.IsObject() && doc.HasMember("method") && doc.HasMember("params") && doc["method"].IsString())
+      {
+        const std::string method{doc["method"].GetString(), doc["method"].GetStringLength()};
+        const rapidjson::Value& params = doc["params"];
+        if (method == "get_hashes_fast" && params.IsObject() && params.HasMember("known_hashes"))
+          return make_hashes(params["known_hashes"]);
+        if (method == "get_blocks_fast" && params.IsObject() && params.HasMember("start_height") && params["start_height"].IsUint64())
+        {
+          const std::uint64_t start = params["start_height"].GetUint64();
+          const auto prepared = prepared_.find(start);
+          if (prepared != prepared_.end())
+            return prepared->second.clone();
+          ++misses_;
+          return make_blocks(start);
+        }
+      }
+
+      std::cerr << "Fake daemon received unsupported request" << std::endl;
+      return epee::byte_slice{std::string{"{\"jsonrpc\":\"2.0\",\"id\":0,\"error\":{\"code\":-32601,\"message\":\"Method not found\"}}"}};
+    }
+
+  public:
+    fake_daemon(const chain& source, const std::uint32_t batch)
+      : chain_(source), batch_(std::max(std::uint32_t(1), batch)), prepared_(), misses_(0)
+    {
+      // each response overlaps the last block of the previous response
+      for (std::uint64_t start = chain_.base + 1; start < chain_.top(); start += batch_)
+        prepared_.emplace(start, make_blocks(start));
+      prepared_.emplace(chain_.top(), make_blocks(chain_.top()));
+    }
+
+    //! \return Number of block responses serialized during the scan.
+    std::uint64_t misses() const noexcept { return misses_; }
+
+    //! Reply to requests until `done`.
+    void run(void* ctx, const std::atomic<bool>& done)
+    {
+      try
+      {
+        net::zmq::socket server{};
+        server.reset(zmq_socket(ctx, ZMQ_REP));
+        const int timeout = 100;
+        if (!server || zmq_setsockopt(server.get(), ZMQ_RCVTIMEO, &timeout, sizeof(timeout)) || zmq_bind(server.get(), daemon_address))
+        {
+          std::cerr << "Failed to create ZMQ server" << std::endl;
+          lws::scanner::stop();
+          return;
+        }
+
+        while (!done)
+        {
+          const expect<std::string> request = net::zmq::receive(server.get(), 0);
+          if (!request)
+          {
+            if (request == net::zmq::make_error_code(EAGAIN))
+              continue;
+            std::cerr << "Fake daemon failed to receive: " << request.error().message() << std::endl;
+            break;
+          }
+
+          const expect<void> sent = net::zmq::send(respond(*request), server.get());
+          if (!sent)
+          {
+            std::cerr << "Fake daemon failed to send: " << sent.error().message() << std::endl;
+            break;
+          }
+        }
+      }
+      catch (const std::exception& e)
+      {
+        std::cerr << "Unexpected exception in fake daemon: " << e.what() << std::endl;
+      }
+      lws::scanner::stop();
+    }
+  };
+
+  std::vector<bench_account> make_accounts(const settings& opts)
+  {
+    hw::core::device_default hw{};
+    std::vector<bench_account> out{};
+    out.reserve(opts.accounts);
+    for (std::uint32_t i = 0; i < opts.accounts; ++i)
+    {
+      out.emplace_back();
+      cryptonote::account_keys& keys = out.back().keys;
+      crypto::generate_keys(keys.m_account_address.m_spend_public_key, keys.m_spend_secret_key);
+      crypto::generate_keys(keys.m_account_address.m_view_public_key, keys.m_view_secret_key);
+      for (std::uint32_t minor = 1; minor <= opts.subaddresses; ++minor)
+        out.back().subaddresses.push_back(hw.get_subaddress(keys, cryptonote::subaddress_index{0, minor}));
+    }
+    return out;
+  }
+
+  lws::db::account_address to_address(const cryptonote::account_public_address& source)
+  {
+    return {source.m_view_public_key, source.m_spend_public_key};
+  }
+
+  int run(const settings& opts)
+  {
+    stages timing{};
+    const std::vector<bench_account> accounts = make_accounts(opts);
+
+    const boost::filesystem::path location =
+      boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("monero-lws-benchmark-%%%%-%%%%");
+    boost::filesystem::create_directories(location);
+    struct cleanup_
+    {
+      const boost::filesystem::path& location;
+      ~cleanup_() { boost::filesystem::remove_all(location); }
+    } cleanup{location};
+
+    lws::db::storage disk = lws::db::storage::open(location.string().c_str(), 5);
+    const lws::db::block_info base = MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_last_block());
+
+    const chain blocks = generator{opts, accounts}.make_chain(base);
+    timing.finish("generate");
+
+    fake_daemon daemon{blocks, opts.batch};
+    timing.finish("serialize");
+
+    lws::scanner::reset();
+    lws::rpc::context ctx =
+      lws::rpc::context::make(daemon_address, {}, {}, {}, std::chrono::minutes{0}, false);
+
+    std::atomic<bool> done{false};
+    void* const zmq_context = ctx.zmq_context();
+    boost::thread server{[&daemon, zmq_context, &done] () { daemon.run(zmq_context, done); }};
+    boost::thread scanner{};
+
+    // `ctx` cannot be destroyed until the fake daemon closes its socket
+    const auto shutdown = [&done, &server, &scanner] ()
+    {
+      lws::scanner::stop();
+      done = true;
+      if (server.joinable())
+        server.join();
+      if (scanner.joinable())
+        scanner.join();
+    };
+    struct shutdown_
+    {
+      const decltype(shutdown)& run;
+      ~shutdown_() { run(); }
+    } on_scope_exit{shutdown};
+
+    MONERO_UNWRAP(lws::scanner::sync(disk.clone(), MONERO_UNWRAP(ctx.connect())));
+    timing.finish("sync");
+
+    // accounts start at first synthetic block, which is also the overlap block
+    std::vector<lws::db::account_address> addresses{};
+    std::vector<lws::db::account_id> ids{};
+    for (const bench_account& account : accounts)
+    {
+      addresses.push_back(to_address(account.keys.m_account_address));
+      MONERO_UNWRAP(disk.add_account(addresses.back(), account.keys.m_view_secret_key));
+      ids.push_back(MONERO_UNWRAP(MONERO_UNWRAP(disk.start_read()).get_account(addresses.back())).second.id);
+      if (opts.subaddresses)
+      {
+        std::vector<lws::db::subaddress_dict> ranges{
+          lws::db::subaddress_dict{
+            lws::db::major_index::primary,
+            lws::db::index_ranges{
+              {lws::db::index_range{lws::db::minor_index(1), lws::db::minor_index(opts.subaddresses)}}
+            }
+          }
+        };
+        MONERO_UNWRAP(
+          disk.upsert_subaddresses(ids.back(), addresses.back(), account.keys.m_view_secret_key, std::move(ranges), opts.subaddresses)
+        );
+      }
+    }
+    MONERO_UNWRAP(disk.rescan(lws::db::block_id(blocks.base + 1), epee::to_span(addresses)));
+    timing.finish("accounts");
+
+    const lws::scanner_options scan_opts{
+      epee::net_utils::ssl_verification_t::none, opts.subaddresses != 0, false, opts.work_pool, false, false
+    };
+    scanner = boost::thread{[&disk, &ctx, &opts, &scan_opts] () {
+      try
+      {
+        lws::scanner::run(disk.clone(), std::move(ctx), opts.threads, scan_opts);
+      }
+      catch (const std::exception& e)
+      {
+        std::cerr << "Scanner failed: " << e.what() << std::endl;
+        lws::scanner::stop();
+      }
+    }};
+
+    bool complete = false;
+    while (!complete && lws::scanner::is_running())
+    {
+      boost::this_thread::sleep_for(boost::chrono::milliseconds{5});
+      complete = true;
+      auto reader = MONERO_UNWRAP(disk.start_read());
+      for (const lws::db::account_id id : ids)
+      {
+        const expect<lws::db::account> account = reader.get_account(lws::db::account_status::active, id);
+        if (!account || std::uint64_t(account->scan_height) < blocks.top())
+        {
+          complete = false;
+          break;
+        }
+      }
+    }
+    const double scan_time = timing.finish("scan");
+    shutdown();
+
+    std::uint64_t found = 0;
+    {
+      auto reader = MONERO_UNWRAP(disk.start_read());
+      for (const lws::db::account_id id : ids)
+        found += MONERO_UNWRAP(reader.get_outputs(id)).count();
+    }
+    timing.finish("verify");
+
+    const std::uint64_t scanned = blocks.blocks.size() - 1; // skips overlap block
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Stages:" << std::endl;
+    timing.print(std::cout);
+    std::cout << "Scan (" << opts.threads << " thread(s), " << accounts.size() << " account(s)):" << std::endl;
+    std::cout << "  blocks/s      " << scanned / scan_time << std::endl;
+    std::cout << "  tx/s          " << blocks.txes / scan_time << std::endl;
+    std::cout << "  outputs/s     " << blocks.outputs / scan_time << std::endl;
+    std::cout << "  derivations/s " << blocks.derivations / scan_time << std::endl;
+    std::cout << "  outputs found " << found << " of " << blocks.received << std::endl;
+    if (daemon.misses())
+      std::cout << "  " << daemon.misses() << " block response(s) serialized during scan" << std::endl;
+
+    if (!complete)
+    {
+      std::cerr << "Scanner stopped before reaching chain top" << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+} // anonymous
+
+int main(int argc, char** argv)
+{
+  tools::on_startup();
+
+  try
+  {
+    namespace po = boost::program_options;
+
+    const options opts{};
+    po::options_description description{"Options"};
+    opts.prepare(description);
+
+    po::variables_map args{};
+    po::store(po::command_line_parser(argc, argv).options(description).run(), args);
+    po::notify(args);
+
+    if (command_line::get_arg(args, command_line::arg_help))
+    {
+      std::cout << "Usage: [options]" << std::endl << description;
+      return EXIT_SUCCESS;
+    }
+
+    mlog_configure("", false);
+    mlog_set_log_level(command_line::get_arg(args, opts.log_level));
+
+    const settings config{
+      command_line::get_arg(args, opts.blocks),
+      command_line::get_arg(args, opts.txes),
+      command_line::get_arg(args, opts.outputs),
+      command_line::get_arg(args, opts.inputs),
+      command_line::get_arg(args, opts.accounts),
+      command_line::get_arg(args, opts.subaddresses),
+      command_line::get_arg(args, opts.hit_rate),
+      command_line::get_arg(args, opts.subaddress_rate),
+      command_line::get_arg(args, opts.tag_hit_rate),
+      command_line::get_arg(args, opts.untagged_rate),
+      command_line::get_arg(args, opts.batch),
+      std::max(std::size_t(1), command_line::get_arg(args, opts.threads)),
+      command_line::get_arg(args, opts.work_pool)
+    };
+
+    if (config.blocks < 2 || config.outputs == 0)
+      throw std::runtime_error{"Need at least 2 blocks and 1 output per transaction"};
+
+    return run(config);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+  }
+  catch (...)
+  {
+    std::cerr << "Unknown exception" << std::endl;
+  }
+  return EXIT_FAILURE;
+}
@@ -178,6 +178,7 @@ LWS_CASE("lws::account serialization")
   EXPECT(copy.view_public() == db_account.address.view_public);
   EXPECT(copy.spend_public() == db_account.address.spend_public);
   EXPECT(copy.view_key() == keys.m_view_secret_key);
+  EXPECT(copy.view_key_digits() == account.view_key_digits());
   EXPECT(copy.scan_height() == db_account.scan_height);
   {
     const auto result = copy.get_spendable(lws::db::output_id{100, 2000});
@@ -219,3 +220,40 @@ LWS_CASE("lws::account serialization")
   EXPECT(copy.spends()[0].sender.maj_i == lws::db::major_index(4));
   EXPECT(copy.spends()[0].sender.min_i == lws::db::minor_index(55));
 }
+
+LWS_CASE("lws::account subaddresses")
+{
+  lws::account account{lws::db::account{}, {}, {}};
+  EXPECT(account.subaddress_count() == 0);
+  EXPECT(!account.find_subaddress(crypto::rand<crypto::public_key>()));
+
+  std::vector<lws::db::subaddress_map> keys;
+  for (std::uint32_t i = 0; i < 100; ++i)
+  {
+    keys.push_back(
+      lws::db::subaddress_map{
+        crypto::rand<crypto::public_key>(),
+        lws::db::address_index{lws::db::major_index(i / 10), lws::db::minor_index(i % 10)}
+      }
+    );
+  }
+
+  account.set_subaddresses(keys);
+  EXPECT(account.subaddress_count() == keys.size());
+  for (auto const& key : keys)
+  {
+    const auto found = account.find_subaddress(key.subaddress);
+    EXPECT(bool(found));
+    EXPECT(found->maj_i == key.index.maj_i);
+    EXPECT(found->min_i == key.index.min_i);
+  }
+  EXPECT(!account.find_subaddress(crypto::rand<crypto::public_key>()));
+
+  const lws::account copy = account.clone();
+  EXPECT(copy.subaddress_count() == keys.size());
+  EXPECT(bool(copy.find_subaddress(keys.front().subaddress)));
+
+  account.set_subaddresses({});
+  EXPECT(account.subaddress_count() == 0);
+  EXPECT(!account.find_subaddress(keys.front().subaddress));
+}
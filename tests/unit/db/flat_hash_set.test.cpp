@@ -0,0 +1,95 @@
+// Copyright (c) 2024, The Monero Project
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "framework.test.h"
+
+#include <cstdint>
+#include <vector>
+#include "db/flat_hash_set.h"
+
+namespace
+{
+  struct traits
+  {
+    static std::uint64_t key(std::pair<std::uint64_t, unsigned> const& value) noexcept { return value.first; }
+    static std::size_t hash(std::uint64_t key) noexcept { return std::size_t(key % 7); } // force collisions
+  };
+  using set = lws::db::flat_hash_set<std::pair<std::uint64_t, unsigned>, traits>;
+}
+
+LWS_CASE("db::flat_hash_set")
+{
+  set values{};
+  EXPECT(values.empty());
+  EXPECT(values.find(std::uint64_t(0)) == nullptr);
+
+  for (std::uint64_t i = 0; i < 1000; ++i)
+  {
+    const auto inserted = values.insert({i * 3, unsigned(i)});
+    EXPECT(inserted.second);
+    EXPECT(inserted.first->first == i * 3);
+  }
+  EXPECT(values.size() == 1000);
+
+  SETUP("Lookups")
+  {
+    for (std::uint64_t i = 0; i < 1000; ++i)
+    {
+      const auto* const found = values.find(i * 3);
+      EXPECT(found != nullptr);
+      EXPECT(found->second == unsigned(i));
+      EXPECT(values.find(i * 3 + 1) == nullptr);
+    }
+  }
+
+  SETUP("Duplicates")
+  {
+    const auto inserted = values.insert({9, 0});
+    EXPECT(!inserted.second);
+    EXPECT(inserted.first->second == 3);
+    EXPECT(values.size() == 1000);
+  }
+
+  SETUP("Insertion order")
+  {
+    std::uint64_t expected = 0;
+    for (auto const& value : values)
+    {
+      EXPECT(value.first == expected);
+      expected += 3;
+    }
+  }
+
+  SETUP("Clear")
+  {
+    values.clear();
+    EXPECT(values.empty());
+    EXPECT(values.find(std::uint64_t(3)) == nullptr);
+    EXPECT(values.emplace_hint(values.end(), {3, 1})->second == 1);
+    EXPECT(values.size() == 1);
+  }
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2024, The Monero Project
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "framework.test.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "crypto/crypto.h" // monero/src
+#include "db/account.h"
+#include "db/data.h"
+#include "db/storage.h"
+#include "db/storage.test.h"
+#include "error.h"
+
+LWS_CASE("db::storage_reader::get_images")
+{
+  lws::db::test::account_db fixture{};
+  const lws::db::account_id id = fixture.id;
+  const lws::db::block_id next_height = fixture.next_height;
+  EXPECT(MONERO_UNWRAP(MONERO_UNWRAP(fixture.db.start_read()).get_images(id)).empty());
+
+  const std::vector<lws::db::output> outs{
+    lws::db::test::make_output(next_height, 300),
+    lws::db::test::make_output(next_height, 100),
+    lws::db::test::make_output(next_height, 200)
+  };
+
+  // two images for output 300 and output 100, output 200 is never spent
+  std::vector<lws::db::spend> spends{
+    lws::db::test::make_spend(next_height, outs[0].spend_meta.id),
+    lws::db::test::make_spend(next_height, outs[1].spend_meta.id),
+    lws::db::test::make_spend(next_height, outs[0].spend_meta.id),
+    lws::db::test::make_spend(next_height, outs[1].spend_meta.id)
+  };
+
+  // same image for output 100 in another tx, only stored once in images table
+  spends.push_back(lws::db::test::make_spend(next_height, outs[1].spend_meta.id));
+  spends.back().image = spends[1].image;
+
+  lws::account full_account = fixture.make_account();
+  for (const lws::db::output& out : outs)
+    EXPECT(full_account.add_out(out));
+  for (const lws::db::spend& spend : spends)
+    full_account.add_spend(spend);
+  EXPECT(fixture.update(full_account));
+
+  lws::db::storage_reader reader = MONERO_UNWRAP(fixture.db.start_read());
+  const auto images = MONERO_UNWRAP(reader.get_images(id));
+  EXPECT(images.size() == 4);
+
+  // sorted by output id, then image, without duplicates
+  for (std::size_t i = 1; i < images.size(); ++i)
+  {
+    const auto& left = images[i - 1];
+    const auto& right = images[i];
+    EXPECT(left.first <= right.first);
+    if (left.first == right.first)
+    {
+      EXPECT(std::memcmp(std::addressof(left.second), std::addressof(right.second), sizeof(left.second)) < 0);
+    }
+  }
+
+  // same join as get_unspent_outs, must match the per-output table lookup
+  for (const lws::db::output& out : outs)
+  {
+    const auto matches = std::equal_range(
+      images.begin(), images.end(), std::make_pair(out.spend_meta.id, crypto::key_image{}),
+      [] (const auto& left, const auto& right) { return left.first < right.first; }
+    );
+
+    auto expected = MONERO_UNWRAP(reader.get_images(out.spend_meta.id));
+    std::vector<crypto::key_image> expected_images{};
+    for (const lws::db::key_image& image : expected.make_range())
+      expected_images.push_back(image.value);
+
+    EXPECT(std::size_t(matches.second - matches.first) == expected_images.size());
+    EXPECT(std::equal(
+      expected_images.begin(), expected_images.end(), matches.first,
+      [] (const crypto::key_image& left, const std::pair<lws::db::output_id, crypto::key_image>& right)
+      {
+        return left == right.second;
+      }
+    ));
+  }
+
+  const auto count = [&images] (const lws::db::output_id source)
+  {
+    return std::count_if(images.begin(), images.end(), [source] (const auto& entry)
+    {
+      return entry.first == source;
+    });
+  };
+  EXPECT(count(outs[0].spend_meta.id) == 2);
+  EXPECT(count(outs[1].spend_meta.id) == 2);
+  EXPECT(count(outs[2].spend_meta.id) == 0);
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2024, The Monero Project
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "framework.test.h"
+
+#include <cstdint>
+#include <vector>
+#include "crypto/crypto.h" // monero/src
+#include "db/data.h"
+#include "db/storage.h"
+#include "db/storage.test.h"
+#include "error.h"
+
+namespace
+{
+  lws::db::scan_index_block make_block(const lws::db::block_id height, const crypto::hash& hash, const crypto::hash& prev_id)
+  {
+    lws::db::scan_index_block out{height, hash, prev_id, 1000 + std::uint64_t(height), 16, 16, {}};
+    out.txes.push_back(lws::db::scan_index_tx{crypto::rand<crypto::hash>(), "miner", {1, 2}});
+    out.txes.push_back(lws::db::scan_index_tx{crypto::rand<crypto::hash>(), std::string("\x00\xff", 2), {3}});
+    return out;
+  }
+}
+
+LWS_CASE("db::storage::*_scan_index")
+{
+  lws::db::test::cleanup_db on_scope_exit{};
+  lws::db::storage db = lws::db::test::get_fresh_db();
+  const lws::db::block_info last_block =
+    MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_last_block());
+  const auto height = [&last_block] (const std::uint64_t offset)
+  {
+    return lws::db::block_id(std::uint64_t(last_block.id) + offset);
+  };
+
+  const crypto::hash chain[4] = {
+    last_block.hash,
+    crypto::rand<crypto::hash>(),
+    crypto::rand<crypto::hash>(),
+    crypto::rand<crypto::hash>()
+  };
+  EXPECT(db.sync_chain(last_block.id, chain));
+
+  const lws::db::scan_index_block blocks[3] = {
+    make_block(height(1), chain[1], chain[0]),
+    make_block(height(2), chain[2], chain[1]),
+    make_block(height(3), chain[3], chain[2])
+  };
+
+  SECTION("Empty")
+  {
+    auto reader = MONERO_UNWRAP(db.start_read());
+    EXPECT(!MONERO_UNWRAP(reader.has_scan_index(height(1), height(3))));
+    EXPECT(MONERO_UNWRAP(reader.get_scan_index(height(1), 10)).empty());
+  }
+
+  SECTION("Add and read back")
+  {
+    EXPECT(db.add_scan_index(blocks));
+    EXPECT(db.add_scan_index({blocks + 1, 1})); // already stored
+
+    auto reader = MONERO_UNWRAP(db.start_read());
+    EXPECT(MONERO_UNWRAP(reader.has_scan_index(height(1), height(3))));
+    EXPECT(!MONERO_UNWRAP(reader.has_scan_index(height(1), height(4))));
+
+    const std::vector<lws::db::scan_index_block> stored =
+      MONERO_UNWRAP(reader.get_scan_index(height(1), 10));
+    EXPECT(stored.size() == 3);
+    for (std::size_t i = 0; i < stored.size() && i < 3; ++i)
+    {
+      EXPECT(stored[i].height == blocks[i].height);
+      EXPECT(stored[i].hash == blocks[i].hash);
+      EXPECT(stored[i].prev_id == blocks[i].prev_id);
+      EXPECT(stored[i].timestamp == blocks[i].timestamp);
+      EXPECT(stored[i].major_version == blocks[i].major_version);
+      EXPECT(stored[i].minor_version == blocks[i].minor_version);
+      EXPECT(stored[i].txes.size() == blocks[i].txes.size());
+      for (std::size_t j = 0; j < stored[i].txes.size() && j < blocks[i].txes.size(); ++j)
+      {
+        EXPECT(stored[i].txes[j].hash == blocks[i].txes[j].hash);
+        EXPECT(stored[i].txes[j].base == blocks[i].txes[j].base);
+        EXPECT(stored[i].txes[j].output_indices == blocks[i].txes[j].output_indices);
+      }
+    }
+
+    EXPECT(MONERO_UNWRAP(reader.get_scan_index(height(2), 1)).size() == 1);
+    EXPECT(MONERO_UNWRAP(reader.get_scan_index(height(4), 10)).empty());
+  }
+
+  SECTION("Gap stops read")
+  {
+    EXPECT(db.add_scan_index({blocks, 1}));
+    EXPECT(db.add_scan_index({blocks + 2, 1}));
+
+    auto reader = MONERO_UNWRAP(db.start_read());
+    EXPECT(MONERO_UNWRAP(reader.get_scan_index(height(1), 10)).size() == 1);
+    EXPECT(!MONERO_UNWRAP(reader.has_scan_index(height(1), height(3))));
+    EXPECT(MONERO_UNWRAP(reader.has_scan_index(height(3), height(3))));
+  }
+
+  SECTION("Rollback removes stale blocks")
+  {
+    EXPECT(db.add_scan_index(blocks));
+
+    const crypto::hash fork[3] = {chain[1], crypto::rand<crypto::hash>(), crypto::rand<crypto::hash>()};
+    EXPECT(db.sync_chain(height(1), fork));
+
+    auto reader = MONERO_UNWRAP(db.start_read());
+    EXPECT(!MONERO_UNWRAP(reader.has_scan_index(height(2), height(2))));
+    EXPECT(MONERO_UNWRAP(reader.get_scan_index(height(1), 10)).size() == 1);
+  }
+}
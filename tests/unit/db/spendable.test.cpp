@@ -0,0 +1,81 @@
+// Copyright (c) 2024, The Monero Project
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "framework.test.h"
+
+#include <cstdint>
+#include <vector>
+#include "crypto/crypto.h" // monero/src
+#include "db/account.h"
+#include "db/data.h"
+#include "db/storage.h"
+#include "db/storage.test.h"
+#include "error.h"
+
+LWS_CASE("db::storage::get_spendables")
+{
+  lws::db::test::account_db fixture{};
+  lws::db::storage& db = fixture.db;
+  const lws::db::account_id id = fixture.id;
+  const lws::db::block_id next_height = fixture.next_height;
+  EXPECT(MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_spendables(id)).empty());
+
+  lws::account full_account = fixture.make_account();
+  EXPECT(full_account.add_out(
+    lws::db::test::make_output(next_height, 200, 1000, 0, {lws::db::major_index(0), lws::db::minor_index(1)})
+  ));
+  EXPECT(full_account.add_out(
+    lws::db::test::make_output(next_height, 100, 1000, 0, {lws::db::major_index(1), lws::db::minor_index(0)})
+  ));
+  EXPECT(fixture.update(full_account));
+
+  const std::vector<lws::db::output> outs = full_account.outputs();
+  EXPECT(outs.size() == 2);
+  {
+    const std::vector<lws::db::spendable_output> spendables =
+      MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_spendables(id));
+    EXPECT(spendables.size() == 2);
+
+    // sorted by height, then output id
+    for (unsigned i = 0; i < 2; ++i)
+    {
+      const lws::db::output& source = outs[1 - i];
+      EXPECT(spendables[i].height == next_height);
+      EXPECT(spendables[i].id == source.spend_meta.id);
+      EXPECT(spendables[i].recipient == source.recipient);
+      EXPECT(spendables[i].pub == source.pub);
+    }
+  }
+
+  SECTION("Removed with chain rollback")
+  {
+    const crypto::hash fork[2] = {fixture.last_block.hash, crypto::rand<crypto::hash>()};
+    EXPECT(db.sync_chain(fixture.last_block.id, fork));
+    EXPECT(MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_spendables(id)).empty());
+    EXPECT(MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_outputs(id)).count() == 0);
+  }
+}
@@ -29,6 +29,7 @@
 #include "storage.test.h"
 
 #include <boost/filesystem/operations.hpp>
+#include <cstring>
 #include "common/util.h"   // monero/src/
 
 namespace lws { namespace db { namespace test
@@ -67,4 +68,72 @@ namespace lws { namespace db { namespace test
   {
     return lws::account{make_db_account(pubs, key), {}, {}};
   }
+
+  output make_output(const block_id height, const std::uint64_t id, const std::uint64_t amount, const std::uint64_t unlock_time, const address_index recipient)
+  {
+    return output{
+      transaction_link{height, crypto::rand<crypto::hash>()},
+      output::spend_meta_{
+        output_id{0, id},
+        amount,
+        std::uint32_t(16),
+        std::uint32_t(0),
+        crypto::rand<crypto::public_key>()
+      },
+      std::uint64_t(10000000),
+      unlock_time,
+      crypto::rand<crypto::hash>(),
+      crypto::rand<crypto::public_key>(),
+      crypto::rand<rct::key>(),
+      {{}, {}, {}, {}, {}, {}, {}},
+      extra_and_length(0),
+      output::payment_id_{},
+      std::uint64_t(100),
+      recipient
+    };
+  }
+
+  spend make_spend(const block_id height, const output_id source)
+  {
+    return spend{
+      transaction_link{height, crypto::rand<crypto::hash>()},
+      crypto::rand<crypto::key_image>(),
+      source,
+      std::uint64_t(66),
+      std::uint64_t(0),
+      std::uint32_t(16),
+      {0, 0, 0},
+      0,
+      crypto::hash{},
+      address_index{}
+    };
+  }
+
+  account_db::account_db()
+    : account{},
+      view{},
+      on_scope_exit{},
+      db(get_fresh_db()),
+      last_block(MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_last_block())),
+      id(1),
+      next_height(std::uint64_t(last_block.id) + 1),
+      next_hash(crypto::rand<crypto::hash>())
+  {
+    crypto::generate_keys(account.spend_public, view);
+    crypto::generate_keys(account.view_public, view);
+    MONERO_UNWRAP(db.add_account(account, view));
+  }
+
+  lws::account account_db::make_account() const
+  {
+    lws::account user = test::make_account(account, view);
+    user.updated(last_block.id);
+    return user;
+  }
+
+  expect<storage::updated> account_db::update(const lws::account& user)
+  {
+    const crypto::hash chain[2] = {last_block.hash, next_hash};
+    return db.update(last_block.id, chain, {std::addressof(user), 1}, nullptr);
+  }
 }}} // lws // db // test
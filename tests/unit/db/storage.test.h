@@ -28,6 +28,8 @@
 #pragma once
 
 #include <boost/filesystem/path.hpp>
+#include <cstdint>
+#include "common/expect.h" // monero/src/
 #include "crypto/crypto.h" // monero/src/
 #include "db/account.h"
 #include "db/data.h"
@@ -43,4 +45,37 @@ namespace lws { namespace db { namespace test
   lws::db::storage get_fresh_db();
   lws::db::account make_db_account(const lws::db::account_address& pubs, const crypto::secret_key& key);
   lws::account make_account(const lws::db::account_address& pubs, const crypto::secret_key& key);
+
+  //! \return Output `id` at `height`, with random keys and hashes.
+  lws::db::output make_output(
+    lws::db::block_id height,
+    std::uint64_t id,
+    std::uint64_t amount = 1000,
+    std::uint64_t unlock_time = 0,
+    lws::db::address_index recipient = {}
+  );
+
+  //! \return Spend of `source` at `height`, with a random key image and tx hash.
+  lws::db::spend make_spend(lws::db::block_id height, lws::db::output_id source);
+
+  //! Fresh database with a single account (id 1).
+  struct account_db
+  {
+    account_db();
+
+    lws::db::account_address account;
+    crypto::secret_key view;
+    cleanup_db on_scope_exit;
+    lws::db::storage db;
+    lws::db::block_info last_block;
+    lws::db::account_id id;
+    lws::db::block_id next_height; //!< Height written by `update`
+    crypto::hash next_hash;        //!< Block hash written by `update`
+
+    //! \return `make_account` for `account`, scanned up to `last_block`.
+    lws::account make_account() const;
+
+    //! Writes `user` in a chain of one block (`next_hash`) after `last_block`.
+    expect<lws::db::storage::updated> update(const lws::account& user);
+  };
 }}} // lws // db // test
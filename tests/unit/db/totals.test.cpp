@@ -0,0 +1,154 @@
+// Copyright (c) 2024, The Monero Project
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include "framework.test.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "crypto/crypto.h" // monero/src
+#include "db/account.h"
+#include "db/data.h"
+#include "db/storage.h"
+#include "db/storage.test.h"
+#include "error.h"
+
+LWS_CASE("db::storage::get_totals")
+{
+  lws::db::test::account_db fixture{};
+  lws::db::storage& db = fixture.db;
+  const lws::db::account_id id = fixture.id;
+  const lws::db::block_id next_height = fixture.next_height;
+  {
+    const lws::db::account_totals totals =
+      MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_totals(id));
+    EXPECT(totals.received == 0);
+    EXPECT(totals.sent == 0);
+    EXPECT(totals.outputs == 0);
+    EXPECT(totals.spends == 0);
+  }
+
+  const lws::db::output unlocked = lws::db::test::make_output(next_height, 100, 1000, 0);
+  const lws::db::output locked =
+    lws::db::test::make_output(next_height, 200, 5000, std::uint64_t(next_height) + 100);
+
+  lws::account full_account = fixture.make_account();
+  EXPECT(full_account.add_out(unlocked));
+  EXPECT(full_account.add_out(locked));
+  const lws::db::spend spent = lws::db::test::make_spend(next_height, unlocked.spend_meta.id);
+  full_account.add_spend(spent);
+  EXPECT(fixture.update(full_account));
+
+  const auto check_totals = [&db, &id, &next_height] ()
+  {
+    lws::db::storage_reader reader = MONERO_UNWRAP(db.start_read());
+    const lws::db::account_totals totals = MONERO_UNWRAP(reader.get_totals(id));
+    EXPECT(totals.received == 6000);
+    EXPECT(totals.sent == 1000);
+    EXPECT(totals.outputs == 2);
+    EXPECT(totals.spends == 1);
+    EXPECT(totals.locked_height == next_height);
+    const lws::db::block_id top = lws::db::block_id(std::numeric_limits<std::uint64_t>::max());
+    EXPECT(MONERO_UNWRAP(reader.get_outputs(id, totals.locked_height, top, 100)).values.size() == 2);
+
+    const auto same_height = MONERO_UNWRAP(reader.get_outputs(id, totals.locked_height, top, 1));
+    EXPECT(same_height.values.size() == 2); // never splits a height
+    EXPECT(!same_height.more);
+
+    const auto spent_range = MONERO_UNWRAP(reader.get_spends(id, next_height, next_height, 1));
+    EXPECT(spent_range.values.size() == 1);
+    EXPECT(!spent_range.more);
+
+    const lws::db::block_id after{std::uint64_t(next_height) + 1};
+    EXPECT(MONERO_UNWRAP(reader.get_outputs(id, after, top, 100)).values.empty());
+  };
+  check_totals();
+
+  SECTION("Spend metadata")
+  {
+    std::vector<lws::db::output_id> sources{locked.spend_meta.id, unlocked.spend_meta.id, lws::db::output_id{0, 300}};
+    std::sort(sources.begin(), sources.end());
+
+    const std::vector<lws::db::output::spend_meta_> metas =
+      MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_spend_metas(id, epee::to_span(sources)));
+    EXPECT(metas.size() == 2);
+    EXPECT(metas[0].id == unlocked.spend_meta.id);
+    EXPECT(metas[0].amount == 1000);
+    EXPECT(metas[1].id == locked.spend_meta.id);
+    EXPECT(metas[1].amount == 5000);
+  }
+
+  SECTION("Duplicates ignored after rescan")
+  {
+    EXPECT(MONERO_UNWRAP(db.rescan(fixture.last_block.id, {std::addressof(fixture.account), 1})).size() == 1);
+
+    lws::account rescanned = fixture.make_account();
+    EXPECT(rescanned.add_out(unlocked));
+    EXPECT(rescanned.add_out(locked));
+    rescanned.add_spend(spent);
+    EXPECT(fixture.update(rescanned));
+    check_totals();
+  }
+
+  SECTION("Only removed rows subtracted on chain rollback")
+  {
+    const lws::db::block_id later{std::uint64_t(next_height) + 1};
+    lws::account later_account = fixture.make_account();
+    later_account.updated(next_height);
+    EXPECT(later_account.add_out(lws::db::test::make_output(later, 300, 700, 0)));
+    later_account.add_spend(lws::db::test::make_spend(later, locked.spend_meta.id));
+    later_account.add_spend(lws::db::test::make_spend(later, unlocked.spend_meta.id));
+
+    const crypto::hash chain[2] = {fixture.next_hash, crypto::rand<crypto::hash>()};
+    EXPECT(db.update(next_height, chain, {std::addressof(later_account), 1}, nullptr));
+    {
+      const lws::db::account_totals totals =
+        MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_totals(id));
+      EXPECT(totals.received == 6700);
+      EXPECT(totals.sent == 7000);
+      EXPECT(totals.outputs == 3);
+      EXPECT(totals.spends == 3);
+    }
+
+    const crypto::hash fork[2] = {fixture.next_hash, crypto::rand<crypto::hash>()};
+    EXPECT(db.sync_chain(next_height, fork));
+    check_totals();
+  }
+
+  SECTION("Subtracted on chain rollback")
+  {
+    const crypto::hash fork[2] = {fixture.last_block.hash, crypto::rand<crypto::hash>()};
+    EXPECT(db.sync_chain(fixture.last_block.id, fork));
+
+    const lws::db::account_totals totals =
+      MONERO_UNWRAP(MONERO_UNWRAP(db.start_read()).get_totals(id));
+    EXPECT(totals.received == 0);
+    EXPECT(totals.sent == 0);
+    EXPECT(totals.outputs == 0);
+    EXPECT(totals.spends == 0);
+  }
+}
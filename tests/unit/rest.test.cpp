@@ -441,6 +441,22 @@ LWS_CASE("rest_server")
         "]}"
       );
 
+      const std::string all_txs = response;
+      message = "{\"address\":\"" + address + "\",\"view_key\":\"" + viewkey + "\",\"limit\":1}";
+      response = invoke(client, "/get_address_txs", message);
+      EXPECT(response == all_txs); // one height, nothing left for another page
+
+      message = "{\"address\":\"" + address + "\",\"view_key\":\"" + viewkey + "\",\"from_height\":4001}";
+      response = invoke(client, "/get_address_txs", message);
+      EXPECT(response ==
+        "{\"total_received\":\"40000\","
+        "\"scanned_height\":" + scan_height + "," +
+        "\"scanned_block_height\":" + scan_height + ","
+        "\"start_height\":" + start_height + ","
+        "\"transaction_height\":" + scan_height + ","
+        "\"blockchain_height\":" + scan_height + "}"
+      );
+
       std::vector<epee::byte_slice> messages;
       messages.emplace_back(get_fee_response());
       boost::thread server_thread(&lws_test::rpc_thread, context.zmq_context(), std::cref(messages));
@@ -471,6 +487,57 @@ LWS_CASE("rest_server")
       );
     }
 
+    SECTION("Paged Transactions")
+    {
+      const lws::db::output first = lws::db::test::make_output(lws::db::block_id(4000), 30);
+      const lws::db::output second = lws::db::test::make_output(lws::db::block_id(4002), 31);
+
+      lws::account real_account{account, {}, {}};
+      real_account.add_out(first);
+      real_account.add_out(second);
+      {
+        std::vector<crypto::hash> hashes{
+          last_block.hash,
+          crypto::rand<crypto::hash>(),
+          crypto::rand<crypto::hash>(),
+          crypto::rand<crypto::hash>(),
+          crypto::rand<crypto::hash>(),
+          crypto::rand<crypto::hash>()
+        };
+
+        EXPECT(db.update(last_block.id, epee::to_span(hashes), {std::addressof(real_account), 1}, {}));
+      }
+
+      const std::string first_hash = epee::to_hex::string(epee::as_byte_span(first.link.tx_hash));
+      const std::string second_hash = epee::to_hex::string(epee::as_byte_span(second.link.tx_hash));
+      const std::string credentials =
+        "{\"address\":\"" + address + "\",\"view_key\":\"" + viewkey + "\"";
+      const std::string next_height = ",\"next_height\":4001}";
+
+      response = invoke(client, "/get_address_txs", credentials + "}");
+      EXPECT(response.find(first_hash) != std::string::npos);
+      EXPECT(response.find(second_hash) != std::string::npos);
+      EXPECT(response.find("next_height") == std::string::npos);
+
+      response = invoke(client, "/get_address_txs", credentials + ",\"limit\":1}");
+      EXPECT(response.find("\"total_received\":\"2000\"") == 1); // account-wide, not the page
+      EXPECT(response.find(first_hash) != std::string::npos);
+      EXPECT(response.find(second_hash) == std::string::npos);
+      EXPECT(next_height.size() <= response.size());
+      EXPECT(response.compare(response.size() - next_height.size(), next_height.size(), next_height) == 0);
+
+      response = invoke(client, "/get_address_txs", credentials + ",\"from_height\":4001,\"limit\":1}");
+      EXPECT(response.find("\"total_received\":\"2000\"") == 1);
+      EXPECT(response.find(first_hash) == std::string::npos);
+      EXPECT(response.find(second_hash) != std::string::npos);
+      EXPECT(response.find("next_height") == std::string::npos);
+
+      response = invoke(client, "/get_address_txs", credentials + ",\"to_height\":4001}");
+      EXPECT(response.find(first_hash) != std::string::npos);
+      EXPECT(response.find(second_hash) == std::string::npos);
+      EXPECT(response.find("next_height") == std::string::npos);
+    }
+
     SECTION("provision_subaddrs")
     {
       const std::string scan_height = std::to_string(std::uint64_t(account.scan_height) + 5);
@@ -0,0 +1,99 @@
+// Copyright (c) 2024, The Monero Project
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "framework.test.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "cryptonote_basic/difficulty.h" // monero/src
+#include "cryptonote_config.h"           // monero/src
+#include "db/data.h"
+#include "db/storage.h"
+#include "util/blocks.h"
+
+LWS_CASE("lws::difficulty_window")
+{
+  using unsigned_int = lws::db::block_difficulty::unsigned_int;
+  static constexpr const std::uint64_t target = DIFFICULTY_TARGET_V2;
+
+  // previous `scan_loop` implementation, used as reference
+  lws::db::pow_window reference{};
+  lws::difficulty_window window{};
+  std::mt19937_64 random{0};
+  std::uint64_t timestamp = 1000000;
+
+  const auto next_reference = [&reference] ()
+  {
+    return cryptonote::next_difficulty(reference.pow_timestamps, reference.cumulative_diffs, target);
+  };
+
+  for (unsigned i = 0; i < 1000; ++i)
+  {
+    // out of order timestamps to stress cut points and median
+    timestamp += random() % 240;
+    const std::uint64_t block_time = timestamp - random() % 600;
+
+    const unsigned_int diff = window.next_difficulty(target);
+    EXPECT(diff == next_reference());
+    EXPECT(window.verify_timestamp(block_time) == lws::verify_timestamp(block_time, reference.median_timestamps));
+    EXPECT(window.verify_timestamp(timestamp - 3000) == lws::verify_timestamp(timestamp - 3000, reference.median_timestamps));
+
+    const unsigned_int last = reference.cumulative_diffs.empty() ?
+      unsigned_int(0) : reference.cumulative_diffs.back();
+    reference.pow_timestamps.push_back(block_time);
+    reference.cumulative_diffs.push_back(diff + last);
+    reference.median_timestamps.push_back(block_time);
+    if (DIFFICULTY_BLOCKS_COUNT < reference.pow_timestamps.size())
+    {
+      reference.pow_timestamps.erase(reference.pow_timestamps.begin());
+      reference.cumulative_diffs.erase(reference.cumulative_diffs.begin());
+    }
+    if (BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW < reference.median_timestamps.size())
+      reference.median_timestamps.erase(reference.median_timestamps.begin());
+
+    window.push(block_time, diff);
+    EXPECT(window.cumulative_difficulty() == reference.cumulative_diffs.back());
+  }
+
+  SETUP("Loaded from db::pow_window")
+  {
+    const lws::difficulty_window loaded{reference};
+    EXPECT(loaded.next_difficulty(target) == next_reference());
+    EXPECT(loaded.cumulative_difficulty() == reference.cumulative_diffs.back());
+    EXPECT(loaded.verify_timestamp(timestamp) == lws::verify_timestamp(timestamp, reference.median_timestamps));
+    EXPECT(loaded.verify_timestamp(timestamp - 3000) == lws::verify_timestamp(timestamp - 3000, reference.median_timestamps));
+  }
+
+  SETUP("Empty window")
+  {
+    const lws::difficulty_window empty{};
+    EXPECT(empty.next_difficulty(target) == 1);
+    EXPECT(empty.cumulative_difficulty() == 0);
+    EXPECT(empty.verify_timestamp(0));
+  }
+}
@@ -0,0 +1,132 @@
+// Copyright (c) 2024, The Monero Project
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "framework.test.h"
+
+#include <array>
+#include <cstring>
+#include <vector>
+#include "crypto/crypto.h" // monero/src
+#include "db/account.h"
+#include "db/data.h"
+#include "util/transactions.h"
+
+namespace
+{
+  lws::account make_account()
+  {
+    crypto::secret_key spend{};
+    crypto::secret_key view{};
+    lws::db::account source{};
+    crypto::generate_keys(source.address.spend_public, spend);
+    crypto::generate_keys(source.address.view_public, view);
+    std::memcpy(
+      std::addressof(source.key), std::addressof(unwrap(unwrap(view))), sizeof(source.key)
+    );
+    return lws::account{source, {}, {}};
+  }
+}
+
+LWS_CASE("lws::generate_key_derivations")
+{
+  crypto::public_key tx_pub{};
+  crypto::secret_key tx_sec{};
+  crypto::generate_keys(tx_pub, tx_sec);
+
+  std::vector<lws::account> accounts;
+  std::vector<std::array<std::int8_t, 64> const*> keys;
+  for (unsigned i = 0; i < 5; ++i)
+    accounts.push_back(make_account());
+  for (auto const& account : accounts)
+    keys.push_back(std::addressof(account.view_key_digits()));
+
+  SETUP("Valid tx public key")
+  {
+    std::vector<crypto::key_derivation> derivations;
+    EXPECT(lws::generate_key_derivations(derivations, tx_pub, epee::to_span(keys)));
+    EXPECT(derivations.size() == accounts.size());
+
+    for (std::size_t i = 0; i < accounts.size(); ++i)
+    {
+      crypto::key_derivation expected{};
+      EXPECT(crypto::generate_key_derivation(tx_pub, accounts[i].view_key(), expected));
+      EXPECT(derivations[i] == expected);
+    }
+
+    EXPECT(lws::generate_key_derivations(derivations, tx_pub, {}));
+    EXPECT(derivations.empty());
+  }
+
+  SETUP("Single view key")
+  {
+    std::vector<crypto::key_derivation> derivations;
+    EXPECT(lws::generate_key_derivations(derivations, tx_pub, {keys.data(), 1}));
+    EXPECT(derivations.size() == 1);
+
+    crypto::key_derivation expected{};
+    EXPECT(crypto::generate_key_derivation(tx_pub, accounts[0].view_key(), expected));
+    EXPECT(derivations[0] == expected);
+  }
+
+  SETUP("Invalid tx public key")
+  {
+    crypto::public_key bad{};
+    do
+    {
+      bad = crypto::rand<crypto::public_key>();
+    } while (crypto::check_key(bad));
+
+    std::vector<crypto::key_derivation> derivations;
+    EXPECT(!lws::generate_key_derivations(derivations, bad, epee::to_span(keys)));
+    EXPECT(derivations.empty());
+  }
+}
+
+LWS_CASE("lws::match_view_tags")
+{
+  // cover the AVX2, SSE2, and scalar tails
+  for (std::size_t count : {0, 1, 15, 16, 17, 31, 32, 33, 70})
+  {
+    std::vector<std::uint8_t> expected(count);
+    std::vector<std::uint8_t> tags(count);
+    std::vector<std::uint32_t> matches;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      expected[i] = std::uint8_t(i * 7);
+      tags[i] = std::uint8_t(i % 3 == 0 ? i * 7 : i * 7 + 1);
+      if (i % 3 == 0)
+        matches.push_back(std::uint32_t(i));
+    }
+
+    std::vector<std::uint32_t> out{42};
+    lws::match_view_tags(out, epee::to_span(expected), epee::to_span(tags));
+    EXPECT(!out.empty());
+    EXPECT(out.front() == 42);
+    out.erase(out.begin());
+    EXPECT(out == matches);
+  }
+}